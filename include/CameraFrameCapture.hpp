@@ -7,6 +7,28 @@
 #include <memory>
 #include <thread>
 #include <vector>
+#include <mutex>
+#include <condition_variable>
+
+class FrameIndex;
+class FrameBufferPool;
+class StereoCompositeSink;
+class StagingTier;
+class OutputStriping;
+class PreviewServer;
+class FrameNotifier;
+class ErrorDispatcher;
+class CpuAccounting;
+struct Frame;
+
+// Pixel layout of frame data
+enum class FrameFormat {
+    Rgb24,      // Packed RGB, width * 3 bytes per row
+    Yuv420,     // Planar full-range YCbCr 4:2:0 (Y, Cb, Cr planes, tightly packed)
+    Yuv422,     // Planar full-range YCbCr 4:2:2
+    Gray8,      // Full-range luma only, width bytes per row
+    Jpeg        // Compressed JPEG bitstream
+};
 
 // Error callback structures
 enum class ErrorType {
@@ -19,9 +41,19 @@ enum class ErrorType {
 
 struct ErrorInfo {
     ErrorType type;
-    std::string message;
+    std::string message;          // Same text for every repeat, e.g. "Failed to publish file: ..."
+    std::string detail;           // What it happened to, usually a file path; may be empty
     uint64_t timestamp;
     bool isFatal;
+
+    // Repeats of one non-fatal error are coalesced (at most one report per
+    // second per type and message): count is how many occurrences this
+    // report stands for, between firstTimestamp and lastTimestamp. detail is
+    // then the last occurrence's and firstDetail the first's.
+    uint64_t count;
+    uint64_t firstTimestamp;
+    uint64_t lastTimestamp;
+    std::string firstDetail;
 };
 
 using ErrorCallback = std::function<void(const ErrorInfo& error)>;
@@ -29,9 +61,251 @@ using ErrorCallback = std::function<void(const ErrorInfo& error)>;
 // Frame statistics
 struct FrameStats {
     uint64_t capturedFrames;
-    uint64_t writtenFrames;
+    uint64_t writtenFrames;       // Composite mode: see CompositeStats::written
     uint64_t droppedFrames;
     float currentFPS;
+    uint64_t pauseCount;          // Backpressure pauses of the input stream
+    uint64_t pausedTimeMs;        // Total time spent paused
+    uint64_t skippedPackets;      // Packets discarded while resyncing to a keyframe
+    uint64_t decimatedFrames;     // Decoded frames not selected for the output rate
+    uint64_t missedSlots;         // Output slots with no input frame near them
+    float selectionJitterMs;      // Mean |frame time - slot time| of selected frames
+    float maxSelectionJitterMs;
+    uint64_t slotGridResets;      // Slot grid re-anchored after a timestamp jump
+    uint64_t stagedFrames;        // Stills waiting in the staging tier
+    uint64_t migratedFrames;      // Stills moved from staging to the output folder
+    uint64_t stagingOverflows;    // Stills written straight to the output folder (staging full)
+    uint64_t notificationsSent;   // Ready-file datagrams delivered
+    uint64_t notificationsDropped; // No consumer listening, or its queue was full
+};
+
+// Compressed stream statistics, collected from demuxed packets over the
+// last completed interval (totals cover the whole session)
+struct PacketStats {
+    float intervalSec;             // Length of the interval these values cover
+    uint64_t packets;              // Video packets in interval
+    uint64_t keyPackets;           // Keyframe (I) packets in interval
+    float bitrateKbps;             // Compressed bitrate over interval
+    float avgPacketBytes;
+    uint32_t minPacketBytes;
+    uint32_t maxPacketBytes;
+    float avgKeyPacketBytes;       // Average I packet size
+    float avgDeltaPacketBytes;     // Average P/B packet size
+    float keyToDeltaRatio;         // avgKeyPacketBytes / avgDeltaPacketBytes (0 if unknown)
+    uint32_t gopLength;            // Packets between the two most recent keyframes (0 if unknown)
+    float avgPtsDeltaMs;           // Mean PTS spacing between consecutive packets
+    float ptsJitterMs;             // Standard deviation of PTS spacing
+    uint64_t totalPackets;
+    uint64_t totalBytes;
+};
+
+// CPU cost of one pipeline stage since start(). Decode and encode include the
+// codec's own worker threads.
+struct CpuStageStats {
+    std::string stage;             // demux, decode, convert, encode, write
+    uint64_t cpuUs;
+    uint64_t calls;
+    float cpuPercent;              // Of one core, averaged since start()
+};
+
+// CPU time and scheduling cost of a pipeline thread, or of a codec's worker
+// threads taken together (threads > 1)
+struct CpuThreadStats {
+    std::string name;              // capture, writer, video writer, decoder workers, ...
+    int threads;                   // Live threads (exited codec workers keep their totals)
+    uint64_t cpuUs;
+    uint64_t voluntarySwitches;    // Blocked: I/O, queue waits
+    uint64_t involuntarySwitches;  // Preempted: more runnable threads than cores
+    uint64_t minorFaults;
+    uint64_t majorFaults;          // Needed disk I/O
+    float cpuPercent;
+};
+
+// Per-camera CPU accounting. Thread figures are sampled about once a second;
+// stage figures are live.
+struct CpuStats {
+    std::string camera;            // Stream URL, or replay path
+    float wallSec;                 // Since start()
+    float cpuPercent;              // All threads below, % of one core
+    std::vector<CpuStageStats> stages;
+    std::vector<CpuThreadStats> threads;
+};
+
+// Output sink selection
+enum class OutputMode {
+    JpegStills,       // One JPEG file per frame (default)
+    VideoSegments,    // Re-encode into rolling H.264/HEVC video segments
+    MjpegPassthrough, // Mux MJPEG packets unchanged into MKV/AVI segments (no decode)
+    Composite         // Hand decoded frames to a StereoCompositeSink (see setCompositeSink)
+};
+
+// Unit of the latency field in JPEG filenames
+enum class LatencyUnit {
+    Milliseconds,     // ..._18ms.jpg (default)
+    Microseconds      // ..._18342us.jpg
+};
+
+// Settings for OutputMode::JpegStills
+struct JpegStillOptions {
+    bool grayscale = false;               // Luma plane only, single-component JPEG
+};
+
+// Settings for OutputMode::VideoSegments
+struct VideoSegmentOptions {
+    std::string encoder = "libx264";      // libavcodec encoder name (libx264, libx265)
+    std::string preset = "ultrafast";
+    std::string tune = "zerolatency";
+    int crf = 23;                         // Constant rate factor (lower = better quality)
+    int keyframeInterval = 30;            // Frames between keyframes (seek granularity)
+    int segmentSeconds = 60;              // Duration of each rolling segment
+    int frameRate = 30;                   // Nominal frame rate for rate control
+    std::string container = "mkv";        // Segment file extension / muxer
+    bool grayscale = false;               // Encode luma only (chroma left neutral)
+};
+
+// Settings for OutputMode::MjpegPassthrough
+struct PassthroughOptions {
+    std::string container = "mkv";        // mkv or avi
+    int segmentSeconds = 60;              // Duration of each rolling segment
+};
+
+// Input backpressure under sustained writer overload: instead of decoding
+// frames only to drop them at the queue, pause reading the stream (RTSP
+// PAUSE/PLAY) until the queue drains, then resume at the next keyframe
+struct BackpressureOptions {
+    bool enabled = false;
+    int windowMs = 2000;                  // Drop-ratio measurement window
+    float dropRatio = 0.5f;               // Pause when this fraction of a window's frames dropped
+    float resumeQueueFraction = 0.25f;    // Resume when the queue is this full or less
+    int maxPauseMs = 5000;                // Upper bound per pause (keeps the RTSP session alive)
+};
+
+// Timestamp used to place decoded frames on the decimation grid
+enum class DecimationClock {
+    HostTime,         // Wall-clock decode time; slots align to wall-clock boundaries
+    HardwareTime      // Stream PTS (camera clock)
+};
+
+// Exact-rate output: keep only the decoded frame nearest to each slot of a
+// fixed grid (k / outputFps), before conversion and encoding
+struct DecimationOptions {
+    bool enabled = false;
+    double outputFps = 10.0;
+    DecimationClock clock = DecimationClock::HostTime;
+};
+
+// Two-tier storage for JPEG stills: land files in a bounded staging folder on
+// tmpfs / RAM disk and move them to the output folder in the background
+struct StagingOptions {
+    bool enabled = false;
+    std::string stagingFolder;                   // e.g. /dev/shm/camera-driver; may be shared
+    uint64_t maxStagedBytes = 256ull << 20;      // Beyond this, write straight to the output folder
+    uint64_t batchBytes = 16ull << 20;           // Migrate once this much is staged...
+    int batchIntervalMs = 500;                   // ...or the oldest staged file is this old
+};
+
+// Spread output files over several disks. Each still (or video/passthrough
+// segment) goes to the least loaded root with free space; index.csv stays in
+// the output folder and records the root of every frame.
+struct StripingOptions {
+    std::vector<std::string> roots;              // One folder per disk; empty disables striping
+    uint64_t minFreeBytes = 1ull << 30;          // Roots with less free space are skipped
+};
+
+// Per-root write statistics (shared by all captures writing to that root)
+struct OutputRootStats {
+    std::string path;
+    uint64_t files;                              // Files finished on this root
+    uint64_t bytes;
+    uint64_t freeBytes;                          // Free space at the last check
+    float writeMBps;                             // Smoothed per-file write speed
+};
+
+// Newest frame of a capture, for live previews and health checks
+struct LatestFrame {
+    FrameFormat format;
+    int width;
+    int height;
+    uint64_t frameNumber;
+    uint64_t computerTimeMs;
+    uint64_t hardwareTimeNs;
+    bool hwTimeValid;
+    std::string file;                            // Still it was written to (empty otherwise)
+    std::shared_ptr<const std::vector<uint8_t>> data;  // Shared with the pipeline; never null
+};
+
+// Local MJPEG-over-HTTP preview (multipart/x-mixed-replace) of the JPEGs the
+// pipeline already encodes; open http://<bindAddress>:<port>/stream.mjpg
+struct PreviewOptions {
+    bool enabled = false;
+    std::string bindAddress = "127.0.0.1";       // 0.0.0.0 to reach it from the field laptop
+    int port = 8080;
+    double maxFps = 5.0;                         // Per client; ?fps=N asks for less
+    int maxClients = 8;
+};
+
+// Feed the pipeline from a packet recording (setPacketRecording) instead of
+// the RTSP stream. At the end of the recording the writers finish the queue
+// and isRunning() turns false; stop() also lets them finish it.
+struct ReplayOptions {
+    std::string path;                     // Empty: connect to the RTSP stream
+    bool realTime = true;                 // Keep recorded arrival gaps; false runs flat out
+};
+
+// Arrangement of the two views in a composite image
+enum class CompositeLayout {
+    SideBySide,       // First view left, second view right
+    Stacked           // First view top, second view bottom
+};
+
+// Which half of a composite a capture feeds
+enum class CompositeView {
+    First,
+    Second
+};
+
+// Settings for StereoCompositeSink
+struct CompositeOptions {
+    CompositeLayout layout = CompositeLayout::SideBySide;
+    int maxSkewMs = 15;                   // Largest timestamp difference paired together
+    bool useHardwareTime = false;         // Pair on stream PTS instead of host receive time
+    int jpegQuality = 85;
+    int encodeThreads = 2;
+    bool frameIndexEnabled = false;       // index.csv in the composite folder
+};
+
+// Composite sink statistics
+struct CompositeStats {
+    uint64_t pairs;                       // Frames paired across the two views
+    uint64_t written;                     // Composite images written
+    uint64_t unpaired;                    // Frames with no partner within maxSkewMs
+    uint64_t mismatched;                  // Pairs whose views differ in size or format
+    uint64_t droppedPairs;                // Pairs dropped because encoding fell behind
+    float avgSkewMs;                      // Mean timestamp difference within pairs
+};
+
+// Joins time-paired frames from two captures into one image (side by side or
+// stacked) by copying their YUV planes, then encodes once. Attach it to two
+// captures in OutputMode::Composite with setCompositeSink(); start it before
+// and stop it after them.
+class StereoCompositeSink {
+public:
+    StereoCompositeSink(const std::string& outputFolder,
+                        const CompositeOptions& options = CompositeOptions());
+    ~StereoCompositeSink();
+
+    StereoCompositeSink(const StereoCompositeSink&) = delete;
+    StereoCompositeSink& operator=(const StereoCompositeSink&) = delete;
+
+    bool start();
+    void stop();
+
+    CompositeStats getStats() const;
+
+private:
+    friend class CameraFrameCapture;
+    class Impl;
+    std::unique_ptr<Impl> impl_;
 };
 
 // Main camera capture driver class
@@ -53,11 +327,73 @@ public:
     void stop();
     bool isRunning() const;
 
-    // Error callback registration
+    // Error callback registration. The callback runs on a dedicated thread,
+    // never on a capture or write thread; it may be replaced at any time.
     void setErrorCallback(ErrorCallback callback);
 
+    // Output configuration (call before start)
+    void setOutputMode(OutputMode mode);
+    void setJpegStillOptions(const JpegStillOptions& options);
+    void setVideoSegmentOptions(const VideoSegmentOptions& options);
+    void setPassthroughOptions(const PassthroughOptions& options);
+    void setCompositeSink(std::shared_ptr<StereoCompositeSink> sink, CompositeView view);
+
+    // Write index.csv with per-frame metadata next to the output
+    // (always on in MjpegPassthrough mode)
+    void setFrameIndexEnabled(bool enabled);
+
+    // Add luma histogram, mean/variance and sharpness columns to the index
+    // for decoded frames (enables the index)
+    void setImageStatsEnabled(bool enabled);
+
+    // Stage JPEG stills on a fast tier before the output folder
+    void setStagingOptions(const StagingOptions& options);
+
+    // Stripe output files across several output roots (call before start)
+    void setStripingOptions(const StripingOptions& options);
+
+    // Announce every committed still or segment on a Unix datagram socket
+    // bound by the consumer (call before start; empty path disables)
+    void setNotificationSocket(const std::string& socketPath);
+
+    // Live preview server (call before start; JpegStills and MjpegPassthrough)
+    void setPreviewOptions(const PreviewOptions& options);
+
+    // Latency field unit in JPEG filenames
+    void setLatencyUnit(LatencyUnit unit);
+
+    // Output rate control (call before start; not applied to passthrough)
+    void setDecimationOptions(const DecimationOptions& options);
+
+    // Record demuxed video packets with their arrival times, or replay such a
+    // recording in place of the RTSP stream (call before start)
+    void setPacketRecording(const std::string& path);
+    void setReplayOptions(const ReplayOptions& options);
+
+    // Overload handling (call before start)
+    void setBackpressureOptions(const BackpressureOptions& options);
+
     // Statistics
     FrameStats getStats() const;
+    PacketStats getPacketStats() const;
+    CpuStats getCpuStats() const;
+    std::vector<OutputRootStats> getOutputRootStats() const;
+
+    // Newest frame without blocking capture; null until there is one. The
+    // slots share the pipeline's buffers, so neither copies pixels.
+    // Decoded: raw pixels of the newest converted frame the pipeline is done
+    // with (written, composed or dropped at the queue).
+    // Encoded: JPEG of the newest written still or passthrough frame.
+    std::shared_ptr<const LatestFrame> getLatestDecodedFrame() const;
+    std::shared_ptr<const LatestFrame> getLatestEncodedFrame() const;
+
+    // One JPEG of the next decoded frame at `quality`, independent of the
+    // output quality, decimation and write queue. The capture thread only
+    // converts that one extra picture; encoding runs on the caller's thread.
+    // Returns false if no frame arrives within timeoutMs. In passthrough
+    // mode the camera's JPEG is returned unchanged.
+    bool snapshot(int quality, std::vector<uint8_t>& jpeg, int timeoutMs = 1000);
+    bool snapshotToFile(const std::string& path, int quality, int timeoutMs = 1000);
 
 private:
     // Internal state
@@ -65,28 +401,102 @@ private:
     std::string outputFolder_;
     int numWriteThreads_;
     int jpegQuality_;
+    OutputMode outputMode_ = OutputMode::JpegStills;
+    JpegStillOptions stillOptions_;
+    VideoSegmentOptions videoOptions_;
+    PassthroughOptions passthroughOptions_;
+    std::shared_ptr<StereoCompositeSink> compositeSink_;
+    CompositeView compositeView_ = CompositeView::First;
+    bool frameIndexEnabled_ = false;
+    bool imageStatsEnabled_ = false;
+    LatencyUnit latencyUnit_ = LatencyUnit::Milliseconds;
+    BackpressureOptions backpressure_;
+    DecimationOptions decimation_;
+    std::string recordPath_;
+    ReplayOptions replayOptions_;
+    StagingOptions stagingOptions_;
+    StripingOptions stripingOptions_;
+    PreviewOptions previewOptions_;
+    std::string notifySocketPath_;
     std::atomic<bool> running_{false};
     std::atomic<bool> shouldStop_{false};
+    std::atomic<bool> captureDone_{false};    // Capture thread has exited
+    std::atomic<int> activeWriters_{0};
 
     // Statistics
     std::atomic<uint64_t> capturedFrames_{0};
     std::atomic<uint64_t> writtenFrames_{0};
     std::atomic<uint64_t> droppedFrames_{0};
     std::atomic<float> currentFPS_{0.0f};
+    std::atomic<uint64_t> pauseCount_{0};
+    std::atomic<uint64_t> pausedTimeMs_{0};
+    std::atomic<uint64_t> skippedPackets_{0};
+    std::atomic<uint64_t> decimatedFrames_{0};
+    std::atomic<uint64_t> missedSlots_{0};
+    std::atomic<uint64_t> slotGridResets_{0};
+    std::atomic<float> selectionJitterMs_{0.0f};
+    std::atomic<float> maxSelectionJitterMs_{0.0f};
+    PacketStats packetStats_{};
+    mutable std::mutex packetStatsMutex_;
+
+    // Latest-frame slots, swapped with std::atomic_store
+    std::shared_ptr<const LatestFrame> latestDecoded_;
+    std::shared_ptr<const LatestFrame> latestEncoded_;
+
+    // Snapshot lane: callers wait for the capture thread to hand over a frame
+    std::mutex snapshotMutex_;
+    std::condition_variable snapshotCv_;
+    std::atomic<int> snapshotWaiters_{0};
+    std::shared_ptr<const Frame> snapshotFrame_;
+    uint64_t snapshotGeneration_ = 0;
 
     // Threads
     std::unique_ptr<std::thread> captureThread_;
     std::vector<std::unique_ptr<std::thread>> writeThreads_;
 
-    // Error callback
-    ErrorCallback errorCallback_;
+    // Runs the error callback on its own thread and coalesces repeats
+    std::unique_ptr<ErrorDispatcher> errorDispatcher_;
+
+    // CPU time per stage and thread of this camera; reset by start()
+    std::unique_ptr<CpuAccounting> cpuAccounting_;
 
     // Shared frame queue (forward declared)
     class FrameQueueImpl;
     std::shared_ptr<FrameQueueImpl> frameQueue_;
 
+    // Recycled frame buffers shared by the capture and write threads
+    std::shared_ptr<FrameBufferPool> bufferPool_;
+
+    // Staging tier for JPEG stills (null when disabled); kept after stop()
+    // so its counters stay readable. start() swaps it, striping_ and
+    // notifier_ with std::atomic_store for getStats() on other threads.
+    std::shared_ptr<StagingTier> staging_;
+
+    // Output roots when striping (null otherwise); kept after stop() like staging_
+    std::shared_ptr<OutputStriping> striping_;
+
+    // Ready-file notifications (null when disabled); kept after stop() like staging_
+    std::shared_ptr<FrameNotifier> notifier_;
+
+    // Live preview server (null when disabled)
+    std::unique_ptr<PreviewServer> preview_;
+
+    // Per-session frame index (null when disabled)
+    std::shared_ptr<FrameIndex> frameIndex_;
+
     // Internal helper methods
     void captureThreadFunc();
     void writeThreadFunc();
-    void reportError(ErrorType type, const std::string& message, bool isFatal);
+    void videoWriteThreadFunc();
+    void passthroughWriteThreadFunc();
+    void compositeWriteThreadFunc();
+    bool writerShouldExit() const;
+    void discardSession();
+    void writerExited();
+    void deliverSnapshot(std::shared_ptr<const Frame> frame);
+    void publishLatest(std::shared_ptr<const LatestFrame>& slot,
+                       std::shared_ptr<const LatestFrame> frame);
+    void retireFrame(Frame& frame);
+    void reportError(ErrorType type, const std::string& message, bool isFatal,
+                     const std::string& detail = "");
 };
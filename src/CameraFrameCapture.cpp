@@ -1,39 +1,85 @@
 #include "CameraFrameCapture.hpp"
+#include "Frame.hpp"
+#include "FrameKernels.hpp"
+#include "VideoSegmentWriter.hpp"
+#include "MjpegRemuxWriter.hpp"
+#include "FrameIndex.hpp"
+#include "ImageStats.hpp"
+#include "FileOutput.hpp"
+#include "FrameBufferPool.hpp"
+#include "StreamSession.hpp"
+#include "StereoCompositeSink.hpp"
+#include "StagingTier.hpp"
+#include "OutputStriping.hpp"
+#include "PreviewServer.hpp"
+#include "FrameNotifier.hpp"
+#include "ErrorDispatcher.hpp"
+#include "Log.hpp"
+#include "CpuAccounting.hpp"
 
-#include <iostream>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
 #include <ctime>
 #include <cstring>
+#include <cerrno>
 #include <cstdio>
 #include <filesystem>
 #include <sstream>
 #include <iomanip>
 #include <memory>
+#include <algorithm>
 
-extern "C" {
-#include <libavformat/avformat.h>
-#include <libavcodec/avcodec.h>
-#include <libavutil/avutil.h>
-#include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
-#include <jpeglib.h>
+namespace fs = std::filesystem;
+
+namespace {
+
+// Moves a buffer into shared ownership; the last holder hands it back to the pool
+std::shared_ptr<const std::vector<uint8_t>> shareBuffer(std::vector<uint8_t>& buffer,
+                                                        std::shared_ptr<FrameBufferPool> pool) {
+    auto* shared = new std::vector<uint8_t>(std::move(buffer));
+    buffer = {};
+    return std::shared_ptr<const std::vector<uint8_t>>(
+        shared, [pool = std::move(pool)](const std::vector<uint8_t>* released) {
+            auto* owned = const_cast<std::vector<uint8_t>*>(released);
+            pool->release(*owned);
+            delete owned;
+        });
 }
 
-namespace fs = std::filesystem;
+// An encode buffer the encoded slot no longer shares. Two per writer, since
+// the slot keeps the one published last.
+std::shared_ptr<std::vector<uint8_t>>& freeEncodeBuffer(
+    std::shared_ptr<std::vector<uint8_t>> (&buffers)[2]) {
+    for (auto& buffer : buffers) {
+        if (buffer && buffer.use_count() == 1) return buffer;
+    }
+    // A reader still holds both: start a new one
+    std::swap(buffers[0], buffers[1]);
+    size_t capacity = buffers[0] ? buffers[0]->capacity() : 0;
+    buffers[1] = std::make_shared<std::vector<uint8_t>>();
+    buffers[1]->reserve(capacity);
+    return buffers[1];
+}
 
-// Frame data structure for queue
-struct Frame {
-    std::vector<uint8_t> data;
-    int width;
-    int height;
-    uint64_t frameNumber;
-    uint64_t computerTimeMs;      // Computer receive time in milliseconds (when frame decoded)
-    uint64_t hardwareTimeNs;      // Hardware timestamp in nanoseconds
-    bool hwTimeValid;             // True if hardware time is from PTS, false if fallback
-};
+std::shared_ptr<const LatestFrame> makeLatestFrame(const Frame& frame,
+                                                   std::shared_ptr<const std::vector<uint8_t>> data,
+                                                   FrameFormat format, const std::string& file) {
+    auto latest = std::make_shared<LatestFrame>();
+    latest->format = format;
+    latest->width = frame.width;
+    latest->height = frame.height;
+    latest->frameNumber = frame.frameNumber;
+    latest->computerTimeMs = frame.computerTimeMs;
+    latest->hardwareTimeNs = frame.hardwareTimeNs;
+    latest->hwTimeValid = frame.hwTimeValid;
+    latest->file = file;
+    latest->data = std::move(data);
+    return latest;
+}
+
+}  // namespace
 
 // Thread-safe queue for frames
 class CameraFrameCapture::FrameQueueImpl {
@@ -43,7 +89,8 @@ public:
     std::condition_variable cv;
     const size_t maxSize = 15;
 
-    bool push(Frame frame) {
+    // Takes the frame only when it is queued; a dropped frame is left to the caller
+    bool push(Frame& frame) {
         std::unique_lock<std::mutex> lock(mutex);
         if (queue.size() >= maxSize) {
             return false;  // Queue full, frame dropped
@@ -77,45 +124,6 @@ public:
     }
 };
 
-// Helper to encode frame to JPEG
-static void encodeFrameToJPEG(const Frame& frame, int quality,
-                              const std::string& filepath) {
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-
-    FILE* outfile = fopen(filepath.c_str(), "wb");
-    if (!outfile) {
-        std::cerr << "Failed to open file: " << filepath << std::endl;
-        return;
-    }
-
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
-    jpeg_stdio_dest(&cinfo, outfile);
-
-    cinfo.image_width = frame.width;
-    cinfo.image_height = frame.height;
-    cinfo.input_components = 3;
-    cinfo.in_color_space = JCS_RGB;
-
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, quality, TRUE);
-    jpeg_start_compress(&cinfo, TRUE);
-
-    JSAMPROW row_pointer[1];
-    const uint8_t* imageData = frame.data.data();
-    int rowStride = frame.width * 3;
-
-    while (cinfo.next_scanline < cinfo.image_height) {
-        row_pointer[0] = (JSAMPROW)(imageData + cinfo.next_scanline * rowStride);
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
-    }
-
-    jpeg_finish_compress(&cinfo);
-    fclose(outfile);
-    jpeg_destroy_compress(&cinfo);
-}
-
 CameraFrameCapture::CameraFrameCapture(
     const std::string& rtspUrl,
     const std::string& outputFolder,
@@ -125,13 +133,19 @@ CameraFrameCapture::CameraFrameCapture(
       outputFolder_(outputFolder),
       numWriteThreads_(numWriteThreads),
       jpegQuality_(jpegQuality),
-      frameQueue_(std::make_shared<FrameQueueImpl>()) {
+      errorDispatcher_(std::make_unique<ErrorDispatcher>()),
+      cpuAccounting_(std::make_unique<CpuAccounting>()),
+      frameQueue_(std::make_shared<FrameQueueImpl>()),
+      // Queued frames plus one in flight per writer, the capture thread and
+      // the latest decoded slot
+      bufferPool_(std::make_shared<FrameBufferPool>(
+          frameQueue_->maxSize + std::max(numWriteThreads, 1) + 2)) {
 
     // Ensure output folder exists
     try {
         fs::create_directories(outputFolder_);
     } catch (const std::exception& e) {
-        std::cerr << "Failed to create output folder: " << e.what() << std::endl;
+        Log::error("Failed to create output folder: {}", e.what());
     }
 }
 
@@ -140,40 +154,150 @@ CameraFrameCapture::~CameraFrameCapture() {
 }
 
 bool CameraFrameCapture::start() {
+    // Threads that ended on a fatal error are joined before starting over
+    if (!running_.load() && captureThread_) {
+        stop();
+    }
+
     if (running_.exchange(true)) {
         return false;  // Already running
     }
 
     shouldStop_.store(false);
+    captureDone_.store(false);
+    cpuAccounting_->reset();
+
+    if (outputMode_ == OutputMode::Composite && !compositeSink_) {
+        running_.store(false);
+        reportError(ErrorType::Other, "Composite mode requires a StereoCompositeSink", true);
+        return false;
+    }
+
+    // Composite frames are indexed by the sink (CompositeOptions::frameIndexEnabled);
+    // an index here would never get a row
+    bool wantIndex = frameIndexEnabled_ || imageStatsEnabled_;
+    if (wantIndex && outputMode_ == OutputMode::Composite) {
+        Log::warning("Frame index is written by the composite sink, not the capture");
+    } else if (wantIndex || outputMode_ == OutputMode::MjpegPassthrough) {
+        frameIndex_ = std::make_shared<FrameIndex>(outputFolder_);
+        if (!frameIndex_->isOpen()) {
+            reportError(ErrorType::WriteError, "Failed to open frame index", false,
+                        frameIndex_->path());
+        }
+    }
+
+    // Frame numbers restart with the session, so old frames would never be replaced
+    std::atomic_store(&latestDecoded_, std::shared_ptr<const LatestFrame>());
+    std::atomic_store(&latestEncoded_, std::shared_ptr<const LatestFrame>());
+
+    std::shared_ptr<OutputStriping> striping;
+    if (!stripingOptions_.roots.empty()) {
+        striping = std::make_shared<OutputStriping>(stripingOptions_.roots,
+                                                    stripingOptions_.minFreeBytes);
+    }
+    std::atomic_store(&striping_, std::move(striping));
+
+    std::atomic_store(&notifier_, std::shared_ptr<FrameNotifier>());
+    if (!notifySocketPath_.empty()) {
+        auto notifier = std::make_shared<FrameNotifier>(notifySocketPath_);
+        if (notifier->open()) {
+            std::atomic_store(&notifier_, std::move(notifier));
+        } else {
+            reportError(ErrorType::Other, notifier->lastError(), false);
+        }
+    }
+
+    std::atomic_store(&staging_, std::shared_ptr<StagingTier>());
+    if (stagingOptions_.enabled && outputMode_ == OutputMode::JpegStills) {
+        auto staging = std::make_shared<StagingTier>(outputFolder_, stagingOptions_, notifier_.get());
+        if (staging->start()) {
+            std::atomic_store(&staging_, std::move(staging));
+        } else {
+            reportError(ErrorType::WriteError, staging->lastError(), false);
+        }
+    }
+
+    // Viewers read the latest encoded slot; nothing extra is encoded for them
+    if (previewOptions_.enabled) {
+        preview_ = std::make_unique<PreviewServer>(previewOptions_,
+                                                   [this] { return getLatestEncodedFrame(); });
+        if (!preview_->start()) {
+            reportError(ErrorType::Other, preview_->lastError(), false);
+            preview_.reset();
+        }
+    }
+
+    // Counted up front so a flat-out replay never sees zero writers while they start
+    bool singleWriter = outputMode_ != OutputMode::JpegStills;
+    int writerCount = singleWriter ? 1 : numWriteThreads_;
+    activeWriters_.store(writerCount);
 
     try {
         captureThread_ = std::make_unique<std::thread>(&CameraFrameCapture::captureThreadFunc, this);
 
-        for (int i = 0; i < numWriteThreads_; ++i) {
+        if (outputMode_ == OutputMode::VideoSegments) {
+            // A single encoder consumes frames in order; it is threaded internally
+            writeThreads_.push_back(
+                std::make_unique<std::thread>(&CameraFrameCapture::videoWriteThreadFunc, this)
+            );
+        } else if (outputMode_ == OutputMode::Composite) {
+            // The sink encodes on its own threads; this one only hands frames over
             writeThreads_.push_back(
-                std::make_unique<std::thread>(&CameraFrameCapture::writeThreadFunc, this)
+                std::make_unique<std::thread>(&CameraFrameCapture::compositeWriteThreadFunc, this)
             );
+        } else if (outputMode_ == OutputMode::MjpegPassthrough) {
+            // Muxing is sequential and cheap; one thread is enough
+            writeThreads_.push_back(
+                std::make_unique<std::thread>(&CameraFrameCapture::passthroughWriteThreadFunc, this)
+            );
+        } else {
+            for (int i = 0; i < numWriteThreads_; ++i) {
+                writeThreads_.push_back(
+                    std::make_unique<std::thread>(&CameraFrameCapture::writeThreadFunc, this)
+                );
+            }
         }
         return true;
     } catch (const std::exception& e) {
-        running_.store(false);
         reportError(ErrorType::ThreadError,
                    std::string("Failed to start threads: ") + e.what(),
                    true);
+        // Writers that never started must not hold up the capture thread
+        activeWriters_.fetch_sub(writerCount - static_cast<int>(writeThreads_.size()));
+        stop();
+        discardSession();
         return false;
     }
 }
 
+void CameraFrameCapture::discardSession() {
+    // A start() that failed leaves nothing of its session behind
+    if (preview_) {
+        preview_->stop();
+        preview_.reset();
+    }
+    if (staging_) {
+        staging_->stop();
+        std::atomic_store(&staging_, std::shared_ptr<StagingTier>());
+    }
+    frameIndex_.reset();
+    std::atomic_store(&notifier_, std::shared_ptr<FrameNotifier>());
+    std::atomic_store(&striping_, std::shared_ptr<OutputStriping>());
+}
+
 void CameraFrameCapture::stop() {
-    if (!running_.exchange(false)) {
+    // A fatal error clears running_ but leaves its threads to be joined here
+    if (!running_.exchange(false) && !captureThread_) {
         return;  // Not running
     }
 
+    // Live writers leave at once; replay writers first finish the queue
     shouldStop_.store(true);
 
     if (captureThread_ && captureThread_->joinable()) {
         captureThread_->join();
     }
+    captureThread_.reset();
 
     for (auto& thread : writeThreads_) {
         if (thread && thread->joinable()) {
@@ -181,298 +305,513 @@ void CameraFrameCapture::stop() {
         }
     }
     writeThreads_.clear();
+
+    if (preview_) {
+        preview_->stop();
+        preview_.reset();
+    }
+
+    // Everything still staged reaches the output folder before stop() returns
+    if (staging_) {
+        staging_->stop();
+    }
+
+    if (frameIndex_) {
+        frameIndex_->flush();
+        frameIndex_.reset();
+    }
+
+    // Errors raised while stopping, and repeats still held back, reach the
+    // callback before stop() returns; so do the threads' last log lines
+    errorDispatcher_->flush();
+    Log::flush();
 }
 
 bool CameraFrameCapture::isRunning() const {
     return running_.load();
 }
 
+bool CameraFrameCapture::writerShouldExit() const {
+    // A replay is written out in full: writers leave once the capture thread
+    // is done and the queue is empty, whether the recording ended or stop() ran
+    if (!replayOptions_.path.empty()) {
+        return captureDone_.load() && frameQueue_->size() == 0;
+    }
+    return shouldStop_.load();
+}
+
+void CameraFrameCapture::writerExited() {
+    // The last writer out of a finished replay ends the capture
+    if (activeWriters_.fetch_sub(1) == 1 && captureDone_.load()) {
+        running_.store(false);
+    }
+}
+
 void CameraFrameCapture::setErrorCallback(ErrorCallback callback) {
-    errorCallback_ = callback;
+    errorDispatcher_->setCallback(std::move(callback));
+}
+
+void CameraFrameCapture::setOutputMode(OutputMode mode) {
+    outputMode_ = mode;
+}
+
+void CameraFrameCapture::setJpegStillOptions(const JpegStillOptions& options) {
+    stillOptions_ = options;
+}
+
+void CameraFrameCapture::setVideoSegmentOptions(const VideoSegmentOptions& options) {
+    videoOptions_ = options;
+}
+
+void CameraFrameCapture::setPassthroughOptions(const PassthroughOptions& options) {
+    passthroughOptions_ = options;
+}
+
+void CameraFrameCapture::setCompositeSink(std::shared_ptr<StereoCompositeSink> sink,
+                                          CompositeView view) {
+    compositeSink_ = std::move(sink);
+    compositeView_ = view;
+}
+
+void CameraFrameCapture::setFrameIndexEnabled(bool enabled) {
+    frameIndexEnabled_ = enabled;
+}
+
+void CameraFrameCapture::setImageStatsEnabled(bool enabled) {
+    imageStatsEnabled_ = enabled;
+}
+
+void CameraFrameCapture::setStagingOptions(const StagingOptions& options) {
+    stagingOptions_ = options;
+}
+
+void CameraFrameCapture::setStripingOptions(const StripingOptions& options) {
+    stripingOptions_ = options;
+}
+
+void CameraFrameCapture::setNotificationSocket(const std::string& socketPath) {
+    notifySocketPath_ = socketPath;
+}
+
+void CameraFrameCapture::setPreviewOptions(const PreviewOptions& options) {
+    previewOptions_ = options;
+}
+
+void CameraFrameCapture::setLatencyUnit(LatencyUnit unit) {
+    latencyUnit_ = unit;
+}
+
+void CameraFrameCapture::setDecimationOptions(const DecimationOptions& options) {
+    decimation_ = options;
+}
+
+void CameraFrameCapture::setPacketRecording(const std::string& path) {
+    recordPath_ = path;
+}
+
+void CameraFrameCapture::setReplayOptions(const ReplayOptions& options) {
+    replayOptions_ = options;
+}
+
+void CameraFrameCapture::setBackpressureOptions(const BackpressureOptions& options) {
+    backpressure_ = options;
 }
 
 FrameStats CameraFrameCapture::getStats() const {
+    // start() may be swapping these on another thread
+    auto staging = std::atomic_load(&staging_);
+    auto notifier = std::atomic_load(&notifier_);
     return {
         capturedFrames_.load(),
         writtenFrames_.load(),
         droppedFrames_.load(),
-        currentFPS_.load()
+        currentFPS_.load(),
+        pauseCount_.load(),
+        pausedTimeMs_.load(),
+        skippedPackets_.load(),
+        decimatedFrames_.load(),
+        missedSlots_.load(),
+        selectionJitterMs_.load(),
+        maxSelectionJitterMs_.load(),
+        slotGridResets_.load(),
+        staging ? staging->stagedFiles() : 0,
+        staging ? staging->migratedFiles() : 0,
+        staging ? staging->overflows() : 0,
+        notifier ? notifier->sent() : 0,
+        notifier ? notifier->dropped() : 0
     };
 }
 
-void CameraFrameCapture::reportError(ErrorType type, const std::string& message, bool isFatal) {
-    if (errorCallback_) {
-        auto ns = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-        ErrorInfo info{
-            type,
-            message,
-            static_cast<uint64_t>(ns),
-            isFatal
-        };
-        errorCallback_(info);
-    }
+PacketStats CameraFrameCapture::getPacketStats() const {
+    std::lock_guard<std::mutex> lock(packetStatsMutex_);
+    return packetStats_;
+}
 
-    if (isFatal) {
-        running_.store(false);
-    }
+CpuStats CameraFrameCapture::getCpuStats() const {
+    return cpuAccounting_->snapshot(replayOptions_.path.empty() ? rtspUrl_ : replayOptions_.path);
 }
 
-void CameraFrameCapture::captureThreadFunc() {
-    // Open input
-    AVFormatContext* formatCtx = avformat_alloc_context();
-    if (!formatCtx) {
-        reportError(ErrorType::ConnectionFailed, "Failed to allocate AVFormatContext", true);
-        return;
-    }
+std::shared_ptr<const LatestFrame> CameraFrameCapture::getLatestDecodedFrame() const {
+    return std::atomic_load(&latestDecoded_);
+}
 
-    // Set low latency options
-    AVDictionary* options = nullptr;
-    av_dict_set(&options, "rtsp_transport", "tcp", 0);
-    av_dict_set(&options, "buffer_size", "32768", 0);
-    av_dict_set(&options, "max_delay", "500000", 0);  // 500ms max delay
+std::shared_ptr<const LatestFrame> CameraFrameCapture::getLatestEncodedFrame() const {
+    return std::atomic_load(&latestEncoded_);
+}
 
-    if (avformat_open_input(&formatCtx, rtspUrl_.c_str(), nullptr, &options) != 0) {
-        av_dict_free(&options);
-        reportError(ErrorType::ConnectionFailed,
-                   "Failed to open RTSP stream: " + rtspUrl_, true);
-        avformat_free_context(formatCtx);
-        return;
+void CameraFrameCapture::publishLatest(std::shared_ptr<const LatestFrame>& slot,
+                                       std::shared_ptr<const LatestFrame> frame) {
+    // Write threads finish out of order; never replace a newer frame
+    auto current = std::atomic_load(&slot);
+    while (!current || current->frameNumber < frame->frameNumber) {
+        if (std::atomic_compare_exchange_weak(&slot, &current, frame)) break;
     }
-    av_dict_free(&options);
+}
 
-    // Find stream info
-    if (avformat_find_stream_info(formatCtx, nullptr) < 0) {
-        reportError(ErrorType::ConnectionFailed, "Failed to find stream info", true);
-        avformat_close_input(&formatCtx);
+void CameraFrameCapture::retireFrame(Frame& frame) {
+    // A converted frame the pipeline is done with becomes the latest decoded
+    // frame; its buffer returns to the pool once no reader holds it
+    if (frame.data.empty() || frame.format == FrameFormat::Jpeg) {
+        bufferPool_->release(frame.data);
         return;
     }
+    publishLatest(latestDecoded_, makeLatestFrame(frame, shareBuffer(frame.data, bufferPool_),
+                                                  frame.format, ""));
+}
 
-    // Find video stream
-    int videoStreamIdx = -1;
-    for (unsigned int i = 0; i < formatCtx->nb_streams; ++i) {
-        if (formatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            videoStreamIdx = i;
-            break;
-        }
-    }
+bool CameraFrameCapture::snapshot(int quality, std::vector<uint8_t>& jpeg, int timeoutMs) {
+    if (!running_.load()) return false;
 
-    if (videoStreamIdx < 0) {
-        reportError(ErrorType::ConnectionFailed, "No video stream found", true);
-        avformat_close_input(&formatCtx);
-        return;
+    std::shared_ptr<const Frame> frame;
+    {
+        std::unique_lock<std::mutex> lock(snapshotMutex_);
+        uint64_t generation = snapshotGeneration_;
+        snapshotWaiters_.fetch_add(1);
+        bool delivered = snapshotCv_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                              [&] { return snapshotGeneration_ != generation; });
+        snapshotWaiters_.fetch_sub(1);
+        if (!delivered) return false;
+        frame = snapshotFrame_;
     }
 
-    // Get codec
-    AVCodecParameters* codecpar = formatCtx->streams[videoStreamIdx]->codecpar;
-    const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
-    if (!codec) {
-        reportError(ErrorType::FrameDecodeError, "Codec not found", true);
-        avformat_close_input(&formatCtx);
-        return;
+    if (frame->format == FrameFormat::Jpeg) {
+        jpeg = frame->data;
+        return true;
     }
+    return encodeFrame(*frame, quality, jpeg);
+}
 
-    AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
-    if (!codecCtx) {
-        reportError(ErrorType::FrameDecodeError, "Failed to allocate codec context", true);
-        avformat_close_input(&formatCtx);
-        return;
+bool CameraFrameCapture::snapshotToFile(const std::string& path, int quality, int timeoutMs) {
+    std::vector<uint8_t> jpeg;
+    if (!snapshot(quality, jpeg, timeoutMs)) return false;
+    if (!publishFileContents(path, jpeg.data(), jpeg.size())) {
+        reportError(ErrorType::WriteError,
+                   std::string("Failed to write snapshot: ") + std::strerror(errno), false, path);
+        return false;
     }
+    return true;
+}
 
-    avcodec_parameters_to_context(codecCtx, codecpar);
-    codecCtx->thread_count = 4;
+void CameraFrameCapture::deliverSnapshot(std::shared_ptr<const Frame> frame) {
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex_);
+        snapshotFrame_ = std::move(frame);
+        snapshotGeneration_++;
+    }
+    snapshotCv_.notify_all();
+}
 
-    if (avcodec_open2(codecCtx, codec, nullptr) < 0) {
-        reportError(ErrorType::FrameDecodeError, "Failed to open codec", true);
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
-        return;
+std::vector<OutputRootStats> CameraFrameCapture::getOutputRootStats() const {
+    std::vector<OutputRootStats> stats;
+    auto striping = std::atomic_load(&striping_);
+    if (striping) {
+        for (size_t i = 0; i < striping->size(); ++i) {
+            stats.push_back(striping->stats(static_cast<int>(i)));
+        }
     }
+    return stats;
+}
 
-    // Allocate frames
-    AVFrame* rawFrame = av_frame_alloc();
-    AVFrame* rgbFrame = av_frame_alloc();
-    AVPacket* packet = av_packet_alloc();
-    SwsContext* swsCtx = nullptr;
-    uint8_t* buffer = nullptr;
-
-    if (!rawFrame || !rgbFrame || !packet) {
-        reportError(ErrorType::FrameDecodeError, "Failed to allocate frame buffers", true);
-        if (rawFrame) av_frame_free(&rawFrame);
-        if (rgbFrame) av_frame_free(&rgbFrame);
-        if (packet) av_packet_free(&packet);
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
-        return;
+void CameraFrameCapture::reportError(ErrorType type, const std::string& message, bool isFatal,
+                                     const std::string& detail) {
+    // Delivered on the dispatcher thread so a slow callback never stalls capture
+    auto ns = static_cast<uint64_t>(
+        std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    errorDispatcher_->post(ErrorInfo{
+        type,
+        message,
+        detail,
+        ns,
+        isFatal,
+        1,
+        ns,
+        ns,
+        detail
+    });
+
+    // Nothing downstream of a fatal error is worth running: the capture
+    // thread stops demuxing and the writers finish (see writerShouldExit)
+    if (isFatal) {
+        running_.store(false);
+        shouldStop_.store(true);
     }
+}
 
-    // Initialize SWS context for RGB conversion
-    swsCtx = sws_getContext(
-        codecCtx->width, codecCtx->height, codecCtx->pix_fmt,
-        codecCtx->width, codecCtx->height, AV_PIX_FMT_RGB24,
-        SWS_FAST_BILINEAR, nullptr, nullptr, nullptr
-    );
-
-    if (!swsCtx) {
-        reportError(ErrorType::FrameDecodeError, "Failed to create SWS context", true);
-        av_frame_free(&rawFrame);
-        av_frame_free(&rgbFrame);
-        av_packet_free(&packet);
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
+void CameraFrameCapture::captureThreadFunc() {
+    Log::setThreadName("capture");
+    // Before the session opens, so the decoder's threads are counted with this one
+    CpuAccounting::Thread* cpuThread = cpuAccounting_->registerThread("capture");
+
+    // Grayscale is a property of the sink; passthrough never decodes
+    bool grayscale = (outputMode_ == OutputMode::JpegStills && stillOptions_.grayscale) ||
+                     (outputMode_ == OutputMode::VideoSegments && videoOptions_.grayscale);
+    StreamSession session(rtspUrl_, outputMode_ == OutputMode::MjpegPassthrough, grayscale);
+
+    // However this thread ends, writers of a replay may drain the queue and exit
+    struct CaptureDoneGuard {
+        std::atomic<bool>& done;
+        ~CaptureDoneGuard() { done.store(true); }
+    } captureDone{captureDone_};
+
+    if (decimation_.enabled && decimation_.outputFps > 0.0) {
+        session.setDecimation(decimation_.outputFps,
+                              decimation_.clock == DecimationClock::HardwareTime);
+    }
+    if (!recordPath_.empty()) {
+        session.setRecording(recordPath_);
+    }
+    if (!replayOptions_.path.empty()) {
+        session.setReplay(replayOptions_.path, replayOptions_.realTime);
+    }
+    if (!session.open()) {
+        reportError(session.lastErrorType(), session.lastError(), true);
+        cpuAccounting_->sample(cpuThread, true);
         return;
     }
 
-    // Allocate buffer for RGB frame
-    int bufferSize = av_image_get_buffer_size(AV_PIX_FMT_RGB24,
-                                               codecCtx->width,
-                                               codecCtx->height, 1);
-    buffer = (uint8_t*)av_malloc(bufferSize);
-    if (!buffer) {
-        reportError(ErrorType::FrameDecodeError, "Failed to allocate RGB buffer", true);
-        sws_freeContext(swsCtx);
-        av_frame_free(&rawFrame);
-        av_frame_free(&rgbFrame);
-        av_packet_free(&packet);
-        avcodec_free_context(&codecCtx);
-        avformat_close_input(&formatCtx);
-        return;
+    if (replayOptions_.path.empty()) {
+        Log::info("Connected to RTSP stream: {}", rtspUrl_);
+    } else {
+        Log::info("Replaying packet recording: {}", replayOptions_.path);
+    }
+    Log::info("Resolution: {}x{}", session.width(), session.height());
+    if (!session.passthrough()) {
+        Log::info("Frame kernels: {}", session.kernels().name);
     }
 
-    av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize,
-                        buffer, AV_PIX_FMT_RGB24,
-                        codecCtx->width, codecCtx->height, 1);
+    auto lastFpsTime = std::chrono::high_resolution_clock::now();
+    uint64_t framesSinceFpsCheck = 0;
 
-    std::cout << "Connected to RTSP stream: " << rtspUrl_ << std::endl;
-    std::cout << "Resolution: " << codecCtx->width << "x" << codecCtx->height << std::endl;
+    // Overload detection: drop ratio over a sliding window of backpressure_.windowMs
+    auto dropWindowStart = lastFpsTime;
+    uint64_t windowFrames = 0;
+    uint64_t windowDrops = 0;
+    bool overloaded = false;
 
-    // Capture loop
-    {
-        auto lastFpsTime = std::chrono::high_resolution_clock::now();
-        uint64_t framesSinceFpsCheck = 0;
-        uint64_t frameCounter = 0;
-
-        while (!shouldStop_.load()) {
-            if (av_read_frame(formatCtx, packet) < 0) {
-                reportError(ErrorType::FrameDecodeError, "Failed to read frame", false);
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                continue;
-            }
+    // A flat-out replay has no live source to fall behind, so it waits for the
+    // writers instead of dropping frames, as long as any writer is left
+    const bool lossless = !replayOptions_.path.empty() && !replayOptions_.realTime;
 
-            if (packet->stream_index != videoStreamIdx) {
-                av_packet_unref(packet);
-                continue;
+    // Queue a frame for the writers and update FPS
+    auto publishFrame = [&](Frame& frame) {
+        while (lossless && activeWriters_.load() > 0 &&
+               frameQueue_->size() >= frameQueue_->maxSize) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        frame.queuedTimeUs = steadyTimeUs();
+        windowFrames++;
+        if (!frameQueue_->push(frame)) {
+            retireFrame(frame);
+            droppedFrames_.fetch_add(1);
+            windowDrops++;
+        } else {
+            capturedFrames_.fetch_add(1);
+        }
+
+        if (backpressure_.enabled) {
+            auto windowElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - dropWindowStart);
+            if (windowElapsed.count() >= backpressure_.windowMs) {
+                overloaded = windowDrops >= windowFrames * backpressure_.dropRatio;
+                windowFrames = 0;
+                windowDrops = 0;
+                dropWindowStart = std::chrono::high_resolution_clock::now();
             }
+        }
 
-            int ret = avcodec_send_packet(codecCtx, packet);
-            av_packet_unref(packet);
+        framesSinceFpsCheck++;
+        auto now = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - lastFpsTime);
 
-            if (ret < 0) continue;
+        if (elapsed.count() >= 1000) {
+            float fps = framesSinceFpsCheck * 1000.0f / elapsed.count();
+            currentFPS_.store(fps);
+            framesSinceFpsCheck = 0;
+            lastFpsTime = now;
+        }
+    };
 
-            ret = avcodec_receive_frame(codecCtx, rawFrame);
-            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) continue;
-            if (ret < 0) {
-                reportError(ErrorType::FrameDecodeError, "Decoding error", false);
-                continue;
+    // Stop pulling from the camera until writers catch up, then resync on a keyframe
+    auto pauseForBackpressure = [&]() {
+        auto pauseStart = std::chrono::high_resolution_clock::now();
+        session.pauseInput();
+        pauseCount_.fetch_add(1);
+
+        size_t resumeDepth = static_cast<size_t>(
+            frameQueue_->maxSize * backpressure_.resumeQueueFraction);
+        while (!shouldStop_.load() && frameQueue_->size() > resumeDepth) {
+            auto paused = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::high_resolution_clock::now() - pauseStart);
+            if (paused.count() >= backpressure_.maxPauseMs) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        session.resumeInput();
+        overloaded = false;
+        windowFrames = 0;
+        windowDrops = 0;
+        dropWindowStart = std::chrono::high_resolution_clock::now();
+
+        pausedTimeMs_.fetch_add(std::chrono::duration_cast<std::chrono::milliseconds>(
+            dropWindowStart - pauseStart).count());
+    };
+
+    // Capture loop: demux -> decode -> convert -> publish
+    while (!shouldStop_.load()) {
+        cpuAccounting_->sample(cpuThread);
+
+        if (overloaded) {
+            pauseForBackpressure();
+            continue;
+        }
+
+        uint64_t cpuNs = threadCpuTimeNs();
+        StageResult demuxed = session.demux();
+        cpuNs = cpuAccounting_->chargeSince(CpuStage::Demux, cpuNs);
+        if (demuxed == StageResult::EndOfStream) {
+            Log::info("Replay finished");
+            break;
+        }
+        if (demuxed == StageResult::Error) {
+            reportError(session.lastErrorType(), session.lastError(), false);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        PacketStats snapshot;
+        if (session.takePacketStats(snapshot)) {
+            std::lock_guard<std::mutex> lock(packetStatsMutex_);
+            packetStats_ = snapshot;
+        }
+
+        if (demuxed == StageResult::Skipped) {
+            skippedPackets_.fetch_add(1);
+            continue;
+        }
+        if (demuxed != StageResult::Ok) continue;
+
+        StageResult decoded = session.decode();
+        cpuAccounting_->chargeSince(CpuStage::Decode, cpuNs);
+        if (decoded == StageResult::Error) {
+            reportError(session.lastErrorType(), session.lastError(), false);
+            continue;
+        }
+        if (decoded != StageResult::Ok) continue;
+
+        // Snapshots take the newest picture even when decimation drops it
+        if (snapshotWaiters_.load() > 0 && !session.passthrough()) {
+            auto still = std::make_shared<Frame>();
+            if (session.convertLatest(*still)) {
+                deliverSnapshot(std::move(still));
             }
+        }
 
-            // Convert to RGB
-            sws_scale(swsCtx,
-                     (const uint8_t* const*)rawFrame->data,
-                     rawFrame->linesize, 0, codecCtx->height,
-                     rgbFrame->data, rgbFrame->linesize);
+        // Decimation picks which decoded pictures are worth converting
+        int selected = session.select();
+        if (const FrameDecimator* decimator = session.decimator()) {
+            const FrameDecimator::Stats& selection = decimator->stats();
+            decimatedFrames_.store(selection.dropped);
+            missedSlots_.store(selection.missedSlots);
+            slotGridResets_.store(selection.resets);
+            if (selection.selected > 0) {
+                selectionJitterMs_.store(selection.jitterSumUs / 1000.0f / selection.selected);
+                maxSelectionJitterMs_.store(selection.maxJitterUs / 1000.0f);
+            }
+        }
 
-            // Create frame data
+        for (int i = 0; i < selected; ++i) {
             Frame frame;
-            frame.width = codecCtx->width;
-            frame.height = codecCtx->height;
-            frame.frameNumber = frameCounter++;
-
-            // Capture computer receive time (milliseconds since epoch)
-            frame.computerTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-
-            // Extract hardware timestamp from frame (convert PTS to nanoseconds)
-            // The PTS is in units of the timebase (typically 1/frame_rate for video)
-            if (rawFrame->pts != AV_NOPTS_VALUE) {
-                // Get the timebase from the stream
-                AVRational timebase = formatCtx->streams[videoStreamIdx]->time_base;
-                // Convert PTS to seconds, then to nanoseconds
-                double ptsSec = (double)rawFrame->pts * av_q2d(timebase);
-                frame.hardwareTimeNs = (uint64_t)(ptsSec * 1e9);
-                frame.hwTimeValid = true;
-            } else {
-                // Fallback: use computer time if hardware timestamp unavailable
-                frame.hardwareTimeNs = frame.computerTimeMs * 1000000;
-                frame.hwTimeValid = false;
+            frame.data = bufferPool_->acquire();
+            uint64_t convertStartNs = threadCpuTimeNs();
+            bool converted = session.convert(frame);
+            cpuAccounting_->chargeSince(CpuStage::Convert, convertStartNs);
+            if (!converted) {
+                bufferPool_->release(frame.data);
+                reportError(session.lastErrorType(), session.lastError(), false);
+                continue;
             }
 
-            // Copy RGB data
-            int imageSize = frame.width * frame.height * 3;
-            frame.data.assign(rgbFrame->data[0],
-                            rgbFrame->data[0] + imageSize);
-
-            // Try to push to queue
-            if (!frameQueue_->push(std::move(frame))) {
-                droppedFrames_.fetch_add(1);
-            } else {
-                capturedFrames_.fetch_add(1);
+            // Old-size buffers would only be regrown; let the pool refill at the new size
+            if (session.takeModeChange()) {
+                bufferPool_->clear();
+                if (session.passthrough()) {
+                    Log::info("Stream changed to {}x{} (rebuilt in {} us)",
+                              session.width(), session.height(), session.lastRebuildUs());
+                } else {
+                    Log::info("Stream changed to {}x{}, frame kernels: {} (rebuilt in {} us)",
+                              session.width(), session.height(), session.kernels().name,
+                              session.lastRebuildUs());
+                }
             }
 
-            // Update FPS
-            framesSinceFpsCheck++;
-            auto now = std::chrono::high_resolution_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now - lastFpsTime);
-
-            if (elapsed.count() >= 1000) {
-                float fps = framesSinceFpsCheck * 1000.0f / elapsed.count();
-                currentFPS_.store(fps);
-                framesSinceFpsCheck = 0;
-                lastFpsTime = now;
+            if (snapshotWaiters_.load() > 0 && session.passthrough()) {
+                deliverSnapshot(std::make_shared<Frame>(frame));
             }
+
+            publishFrame(frame);
         }
     }
 
-    // Cleanup
-    if (buffer) av_free(buffer);
-    if (swsCtx) sws_freeContext(swsCtx);
-    if (rgbFrame) av_frame_free(&rgbFrame);
-    if (rawFrame) av_frame_free(&rawFrame);
-    if (packet) av_packet_free(&packet);
-    if (codecCtx) avcodec_free_context(&codecCtx);
-    if (formatCtx) avformat_close_input(&formatCtx);
-
-    std::cout << "Capture thread exiting" << std::endl;
+    cpuAccounting_->sample(cpuThread, true);
+    Log::info("Capture thread exiting");
 }
 
 void CameraFrameCapture::writeThreadFunc() {
+    Log::setThreadName("writer");
+    CpuAccounting::Thread* cpuThread = cpuAccounting_->registerThread("writer");
     Frame frame;
     uint64_t localWriteCounter = 0;
+    std::shared_ptr<std::vector<uint8_t>> jpegBuffers[2];  // Reused; shared with the encoded slot
 
-    while (!shouldStop_.load()) {
+    while (!writerShouldExit()) {
+        cpuAccounting_->sample(cpuThread);
+        retireFrame(frame);  // Previous frame is done with its buffer
         if (frameQueue_->pop(frame, 100)) {
-            // Format computer time as YYYY.MM.DD_HH.MM.SS.mmm
-            time_t seconds = frame.computerTimeMs / 1000;
-            uint64_t milliseconds = frame.computerTimeMs % 1000;
-            struct tm* timeinfo = localtime(&seconds);
-
-            std::ostringstream timeStr;
-            timeStr << std::setfill('0')
-                    << (timeinfo->tm_year + 1900) << "."
-                    << std::setw(2) << (timeinfo->tm_mon + 1) << "."
-                    << std::setw(2) << timeinfo->tm_mday << "_"
-                    << std::setw(2) << timeinfo->tm_hour << "."
-                    << std::setw(2) << timeinfo->tm_min << "."
-                    << std::setw(2) << timeinfo->tm_sec << "."
-                    << std::setw(3) << milliseconds;
-
-            // Measure encode + write time
-            auto encodeStartTime = std::chrono::high_resolution_clock::now();
-
-            // Generate temporary filename for encoding
+            std::shared_ptr<std::vector<uint8_t>>& jpegBuffer = freeEncodeBuffer(jpegBuffers);
+            std::vector<uint8_t>& jpeg = *jpegBuffer;
+            FrameTiming timing;
+            uint64_t encodeStartUs = steadyTimeUs();
+            timing.queueWaitUs = encodeStartUs - frame.queuedTimeUs;
+
+            // Encode JPEG into memory
+            uint64_t encodeStartNs = threadCpuTimeNs();
+            bool encoded = encodeFrame(frame, jpegQuality_, jpeg);
+            cpuAccounting_->chargeSince(CpuStage::Encode, encodeStartNs);
+            if (!encoded) {
+                reportError(ErrorType::WriteError, "JPEG encode failed", false);
+                continue;
+            }
+
+            // Everything from here to the index row, failed writes included
+            StageCpuTimer writeCpu(*cpuAccounting_, CpuStage::Write);
+
+            uint64_t writeStartUs = steadyTimeUs();
+            timing.encodeUs = writeStartUs - encodeStartUs;
+
+            // Generate filename base: time + hardware timestamp
             std::ostringstream oss;
-            oss << outputFolder_ << "/"
-                << timeStr.str() << "_";
+            oss << formatComputerTime(frame.computerTimeMs) << "_";
 
             if (frame.hwTimeValid) {
                 oss << "HW_" << frame.hardwareTimeNs;
@@ -480,34 +819,219 @@ void CameraFrameCapture::writeThreadFunc() {
                 oss << "ERR_" << frame.hardwareTimeNs;
             }
 
-            std::string tempFilepath = oss.str() + ".jpg";
-
-            // Encode and write JPEG
-            encodeFrameToJPEG(frame, jpegQuality_, tempFilepath);
+            // Pick the disk for this still
+            int root = -1;
+            if (striping_) {
+                root = striping_->acquire(jpeg.size());
+                if (root < 0) {
+                    reportError(ErrorType::WriteError, "No output root has free space", false);
+                    continue;
+                }
+            }
+            const std::string& destination = root >= 0 ? striping_->root(root) : outputFolder_;
+
+            // Staged stills reach their destination later under the same name
+            bool staged = staging_ && staging_->reserve(jpeg.size());
+            const std::string& folder = staged ? staging_->folder() : destination;
+
+            std::string baseName = oss.str();
+
+            // Write JPEG without a visible name; readers only ever see complete files
+            UnpublishedFile output;
+            if (!output.write(folder, jpeg.data(), jpeg.size())) {
+                if (staged) staging_->cancel(jpeg.size());
+                if (root >= 0) striping_->release(root, jpeg.size(), 0, 0);
+                reportError(ErrorType::WriteError,
+                           std::string("Failed to write file: ") + std::strerror(errno),
+                           false, folder);
+                continue;
+            }
 
-            auto encodeEndTime = std::chrono::high_resolution_clock::now();
-            uint64_t encodeTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-                encodeEndTime - encodeStartTime).count();
+            // Publish under a name that includes encode + write latency
+            timing.writeUs = steadyTimeUs() - writeStartUs;
+            uint64_t latencyUs = timing.latencyUs();
 
-            // Rename file to include encoding time
             std::ostringstream finalOss;
-            finalOss << outputFolder_ << "/"
-                     << timeStr.str() << "_";
-
-            if (frame.hwTimeValid) {
-                finalOss << "HW_" << frame.hardwareTimeNs;
+            finalOss << baseName << "_";
+            if (latencyUnit_ == LatencyUnit::Microseconds) {
+                finalOss << latencyUs << "us.jpg";
             } else {
-                finalOss << "ERR_" << frame.hardwareTimeNs;
+                finalOss << latencyUs / 1000 << "ms.jpg";
+            }
+            std::string finalName = finalOss.str();
+            std::string finalPath = folder + "/" + finalName;
+
+            if (!output.publish(finalPath)) {
+                if (staged) staging_->cancel(jpeg.size());
+                if (root >= 0) striping_->release(root, jpeg.size(), 0, 0);
+                reportError(ErrorType::WriteError,
+                           std::string("Failed to publish file: ") + std::strerror(errno),
+                           false, finalPath);
+                continue;
             }
 
-            finalOss << "_" << encodeTimeMs << "ms.jpg";
-
-            std::rename(tempFilepath.c_str(), finalOss.str().c_str());
+            // Consumers hear about a still once it is complete at its final path
+            FrameNotice notice;
+            if (notifier_) {
+                notice.frameNumber = frame.frameNumber;
+                notice.computerTimeMs = frame.computerTimeMs;
+                notice.hardwareTimeNs = frame.hardwareTimeNs;
+                notice.hwTimeValid = frame.hwTimeValid;
+                notice.bytes = jpeg.size();
+                notice.path = finalPath;
+            }
+            if (staged) {
+                staging_->commit(finalName, jpeg.size(), destination, notice);
+            } else if (notifier_) {
+                notifier_->send(notice);
+            }
+            if (root >= 0) {
+                // Staged writes did not touch the disk; keep them out of its speed estimate
+                striping_->release(root, jpeg.size(), jpeg.size(), staged ? 0 : timing.writeUs);
+            }
+            publishLatest(latestEncoded_, makeLatestFrame(frame, jpegBuffer, FrameFormat::Jpeg,
+                                                          finalName));
+
+            if (frameIndex_) {
+                // After the commit, so QA statistics stay out of the write latency
+                ImageStats imageStats;
+                if (imageStatsEnabled_) {
+                    imageStats = computeImageStats(frame);
+                }
+
+                frameIndex_->append({
+                    frame.frameNumber,
+                    frame.computerTimeMs,
+                    frame.hardwareTimeNs,
+                    frame.hwTimeValid,
+                    latencyUs / 1000,
+                    timing,
+                    frame.packetTimeUs,
+                    frame.computerTimeUs,
+                    systemTimeUs(),
+                    jpeg.size(),
+                    finalName,
+                    -1,
+                    -1,
+                    -1,
+                    std::move(frame.sei),
+                    imageStats,
+                    root >= 0 ? destination : std::string()
+                });
+            }
 
             writtenFrames_.fetch_add(1);
             localWriteCounter++;
         }
     }
+    retireFrame(frame);
+
+    cpuAccounting_->sample(cpuThread, true);
+    Log::info("Write thread exiting (wrote {} frames)", localWriteCounter);
+    writerExited();
+}
+
+void CameraFrameCapture::videoWriteThreadFunc() {
+    Log::setThreadName("video writer");
+    // Before the writer opens its encoder, so the encoder's threads are counted
+    CpuAccounting::Thread* cpuThread = cpuAccounting_->registerThread("video writer");
+    VideoSegmentWriter writer(outputFolder_, videoOptions_, numWriteThreads_, frameIndex_.get(),
+                              striping_.get(), notifier_.get());
+    if (!writer.encoderAvailable()) {
+        reportError(ErrorType::WriteError,
+                   "Video encoder not available: " + videoOptions_.encoder, true);
+        writerExited();
+        return;
+    }
+
+    Frame frame;
+    while (!writerShouldExit()) {
+        retireFrame(frame);
+        if (!frameQueue_->pop(frame, 100)) continue;
+
+        cpuAccounting_->sample(cpuThread);
+        FrameTiming timing;
+        timing.queueWaitUs = steadyTimeUs() - frame.queuedTimeUs;
+        ImageStats imageStats;
+        if (imageStatsEnabled_ && frameIndex_) {
+            imageStats = computeImageStats(frame);
+        }
+
+        bool written;
+        {
+            // Encode, mux and write are one call here
+            StageCpuTimer encodeCpu(*cpuAccounting_, CpuStage::Encode);
+            written = writer.write(frame, timing, imageStats);
+        }
+        if (written) {
+            writtenFrames_.fetch_add(1);
+        } else {
+            reportError(ErrorType::WriteError, writer.lastError(), false, writer.lastErrorDetail());
+        }
+    }
+
+    retireFrame(frame);
+    writer.close();
+    cpuAccounting_->sample(cpuThread, true);
+    Log::info("Video write thread exiting (wrote {} segments, {} bytes)",
+              writer.segmentsWritten(), writer.bytesWritten());
+    writerExited();
+}
+
+void CameraFrameCapture::passthroughWriteThreadFunc() {
+    Log::setThreadName("passthrough writer");
+    CpuAccounting::Thread* cpuThread = cpuAccounting_->registerThread("passthrough writer");
+    MjpegRemuxWriter writer(outputFolder_, passthroughOptions_, frameIndex_.get(), striping_.get(),
+                            notifier_.get());
+    Frame frame;
+
+    while (!writerShouldExit()) {
+        bufferPool_->release(frame.data);
+        if (!frameQueue_->pop(frame, 100)) continue;
+
+        FrameTiming timing;
+        timing.queueWaitUs = steadyTimeUs() - frame.queuedTimeUs;
+
+        cpuAccounting_->sample(cpuThread);
+        bool written;
+        {
+            StageCpuTimer writeCpu(*cpuAccounting_, CpuStage::Write);
+            written = writer.write(frame, timing);
+        }
+        if (written) {
+            writtenFrames_.fetch_add(1);
+            // The camera's JPEG itself; its buffer returns to the pool with the slot
+            publishLatest(latestEncoded_, makeLatestFrame(frame, shareBuffer(frame.data, bufferPool_),
+                                                          FrameFormat::Jpeg, ""));
+        } else {
+            reportError(ErrorType::WriteError, writer.lastError(), false, writer.lastErrorDetail());
+        }
+    }
+
+    writer.close();
+    cpuAccounting_->sample(cpuThread, true);
+    Log::info("Passthrough write thread exiting (wrote {} segments, {} bytes)",
+              writer.segmentsWritten(), writer.bytesWritten());
+    writerExited();
+}
+
+void CameraFrameCapture::compositeWriteThreadFunc() {
+    Log::setThreadName("composite writer");
+    CpuAccounting::Thread* cpuThread = cpuAccounting_->registerThread("composite writer");
+    compositeSink_->impl_->setRelease(compositeView_, [this](Frame& done) { retireFrame(done); });
+    Frame frame;
+
+    while (!writerShouldExit()) {
+        cpuAccounting_->sample(cpuThread);
+        if (!frameQueue_->pop(frame, 100)) continue;
+
+        // Written frames are counted by the sink, per pair (CompositeStats::written)
+        compositeSink_->impl_->submit(compositeView_, std::move(frame));
+    }
 
-    std::cout << "Write thread exiting (wrote " << localWriteCounter << " frames)" << std::endl;
+    cpuAccounting_->sample(cpuThread, true);
+    // Frames the sink still holds are freed from here on, not handed back
+    compositeSink_->impl_->setRelease(compositeView_, nullptr);
+    Log::info("Composite write thread exiting");
+    writerExited();
 }
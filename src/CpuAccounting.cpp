@@ -0,0 +1,298 @@
+#include "CpuAccounting.hpp"
+#include "Frame.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+
+namespace {
+
+constexpr uint64_t kSampleIntervalUs = 1000000;
+
+const char* const kStageNames[] = {"demux", "decode", "convert", "encode", "write"};
+const char* const kWorkerNames[] = {"demux workers", "decoder workers", "convert workers",
+                                    "encoder workers", "write workers"};
+
+// Codec opens and pipeline thread naming, across all cameras
+std::mutex& codecOpenMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+thread_local CpuAccounting* currentAccounting = nullptr;
+thread_local CpuAccounting::Thread* currentThread = nullptr;
+
+std::vector<pid_t> listThreads() {
+    std::vector<pid_t> tids;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return tids;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9') {
+            tids.push_back(static_cast<pid_t>(std::atoi(entry->d_name)));
+        }
+    }
+    closedir(dir);
+    std::sort(tids.begin(), tids.end());
+    return tids;
+}
+
+// Read a small /proc file; false if the thread is gone
+bool readTaskFile(pid_t tid, const char* file, char* buffer, size_t size) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/%s", static_cast<int>(tid), file);
+    FILE* f = fopen(path, "re");
+    if (!f) return false;
+    size_t length = fread(buffer, 1, size - 1, f);
+    fclose(f);
+    buffer[length] = '\0';
+    return length > 0;
+}
+
+std::string threadName(pid_t tid) {
+    char comm[32];
+    if (!readTaskFile(tid, "comm", comm, sizeof(comm))) return "";
+    comm[strcspn(comm, "\n")] = '\0';
+    return comm;
+}
+
+uint64_t statusValue(const char* status, const char* key) {
+    const char* line = strstr(status, key);
+    return line ? std::strtoull(line + strlen(key), nullptr, 10) : 0;
+}
+
+// Start time of a thread in clock ticks since boot; 0 if it is gone. Tells a
+// worker apart from a later thread that reuses its id.
+uint64_t taskStartTime(const char* stat, uint64_t* minorFaults, uint64_t* majorFaults) {
+    // Fields after "(comm)": state is field 3, minflt 10, majflt 12, starttime 22
+    const char* p = strrchr(stat, ')');
+    if (!p || !p[1]) return 0;
+    uint64_t fields[20] = {};
+    p += 2;
+    for (int i = 0; i < 20; ++i) {
+        fields[i] = std::strtoull(p, nullptr, 10);
+        p = strchr(p, ' ');
+        if (!p) break;
+        ++p;
+    }
+    if (minorFaults) *minorFaults = fields[7];
+    if (majorFaults) *majorFaults = fields[9];
+    return fields[19];
+}
+
+// Another thread of this process, from /proc (its getrusage is not reachable)
+bool sampleTask(pid_t tid, uint64_t startTime, uint64_t& cpuNs, uint64_t (&counts)[4]) {
+    char buffer[2048];
+    if (!readTaskFile(tid, "stat", buffer, sizeof(buffer)) ||
+        taskStartTime(buffer, &counts[2], &counts[3]) != startTime) {
+        return false;
+    }
+
+    if (!readTaskFile(tid, "schedstat", buffer, sizeof(buffer))) return false;
+    cpuNs = std::strtoull(buffer, nullptr, 10);
+
+    if (!readTaskFile(tid, "status", buffer, sizeof(buffer))) return false;
+    counts[0] = statusValue(buffer, "\nvoluntary_ctxt_switches:");
+    counts[1] = statusValue(buffer, "\nnonvoluntary_ctxt_switches:");
+    return true;
+}
+
+}  // namespace
+
+uint64_t threadCpuTimeNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void CpuAccounting::Usage::add(const Usage& other) {
+    cpuNs += other.cpuNs;
+    voluntarySwitches += other.voluntarySwitches;
+    involuntarySwitches += other.involuntarySwitches;
+    minorFaults += other.minorFaults;
+    majorFaults += other.majorFaults;
+}
+
+CpuAccounting::CpuAccounting() {
+    reset();
+}
+
+CpuAccounting::~CpuAccounting() = default;
+
+void CpuAccounting::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.clear();
+    for (auto& retired : retiredWorkers_) {
+        retired = Usage();
+    }
+    for (auto& stage : stages_) {
+        stage.ns.store(0);
+        stage.calls.store(0);
+    }
+    startUs_ = steadyTimeUs();
+}
+
+CpuAccounting::Thread* CpuAccounting::registerThread(const char* name) {
+    // Codec threads inherit this name, which is how CodecThreadScope knows them
+    {
+        std::lock_guard<std::mutex> lock(codecOpenMutex());
+        char comm[16];
+        snprintf(comm, sizeof(comm), "%s", name);
+        pthread_setname_np(pthread_self(), comm);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.emplace_back();
+    Thread* thread = &threads_.back();
+    thread->name = name;
+    currentAccounting = this;
+    currentThread = thread;
+    return thread;
+}
+
+void CpuAccounting::sample(Thread* thread, bool force) {
+    uint64_t nowUs = steadyTimeUs();
+    if (!force && nowUs < thread->nextSampleUs) return;
+    thread->nextSampleUs = nowUs + kSampleIntervalUs;
+
+    Usage usage;
+    usage.cpuNs = threadCpuTimeNs();
+    rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+        usage.voluntarySwitches = static_cast<uint64_t>(ru.ru_nvcsw);
+        usage.involuntarySwitches = static_cast<uint64_t>(ru.ru_nivcsw);
+        usage.minorFaults = static_cast<uint64_t>(ru.ru_minflt);
+        usage.majorFaults = static_cast<uint64_t>(ru.ru_majflt);
+    }
+
+    // Sample codec workers outside the lock; /proc reads are slow
+    std::vector<Worker> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        workers = thread->workers;
+    }
+    std::vector<bool> alive(workers.size());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        uint64_t counts[4] = {};
+        uint64_t cpuNs = 0;
+        alive[i] = sampleTask(workers[i].tid, workers[i].startTime, cpuNs, counts);
+        if (alive[i]) {
+            workers[i].usage = {cpuNs, counts[0], counts[1], counts[2], counts[3]};
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread->usage = usage;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        thread->workers[i].usage = workers[i].usage;
+    }
+    // An exited worker keeps its last sample
+    for (size_t i = workers.size(); i-- > 0;) {
+        if (alive[i]) continue;
+        retiredWorkers_[static_cast<int>(workers[i].stage)].add(thread->workers[i].usage);
+        thread->workers.erase(thread->workers.begin() + static_cast<long>(i));
+    }
+}
+
+void CpuAccounting::adoptWorkers(Thread* owner, CpuStage stage, const std::vector<pid_t>& tids) {
+    std::vector<Worker> workers;
+    for (pid_t tid : tids) {
+        char stat[2048];
+        uint64_t startTime = 0;
+        if (readTaskFile(tid, "stat", stat, sizeof(stat))) {
+            startTime = taskStartTime(stat, nullptr, nullptr);
+        }
+        if (startTime != 0) {
+            workers.push_back({tid, startTime, stage, Usage()});
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    owner->workers.insert(owner->workers.end(), workers.begin(), workers.end());
+}
+
+CpuStats CpuAccounting::snapshot(const std::string& camera) const {
+    CpuStats stats{};
+    stats.camera = camera;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.wallSec = (steadyTimeUs() - startUs_) / 1e6f;
+    float wallUs = std::max(stats.wallSec * 1e6f, 1.0f);
+    auto percent = [&](uint64_t cpuNs) { return cpuNs / 1000.0f / wallUs * 100.0f; };
+
+    // Codec workers are grouped per stage across all owners
+    Usage workerUsage[static_cast<int>(CpuStage::Count)];
+    int workerCount[static_cast<int>(CpuStage::Count)] = {};
+    for (int i = 0; i < static_cast<int>(CpuStage::Count); ++i) {
+        workerUsage[i] = retiredWorkers_[i];
+    }
+
+    uint64_t totalNs = 0;
+    for (const Thread& thread : threads_) {
+        stats.threads.push_back({thread.name, 1, thread.usage.cpuNs / 1000,
+                                 thread.usage.voluntarySwitches, thread.usage.involuntarySwitches,
+                                 thread.usage.minorFaults, thread.usage.majorFaults,
+                                 percent(thread.usage.cpuNs)});
+        totalNs += thread.usage.cpuNs;
+        for (const Worker& worker : thread.workers) {
+            workerUsage[static_cast<int>(worker.stage)].add(worker.usage);
+            workerCount[static_cast<int>(worker.stage)]++;
+        }
+    }
+
+    for (int i = 0; i < static_cast<int>(CpuStage::Count); ++i) {
+        const Usage& usage = workerUsage[i];
+        if (usage.cpuNs > 0 || workerCount[i] > 0) {
+            stats.threads.push_back({kWorkerNames[i], workerCount[i], usage.cpuNs / 1000,
+                                     usage.voluntarySwitches, usage.involuntarySwitches,
+                                     usage.minorFaults, usage.majorFaults,
+                                     percent(usage.cpuNs)});
+            totalNs += usage.cpuNs;
+        }
+
+        uint64_t stageNs = stages_[i].ns.load(std::memory_order_relaxed) + usage.cpuNs;
+        uint64_t calls = stages_[i].calls.load(std::memory_order_relaxed);
+        if (stageNs > 0 || calls > 0) {
+            stats.stages.push_back({kStageNames[i], stageNs / 1000, calls, percent(stageNs)});
+        }
+    }
+
+    stats.cpuPercent = percent(totalNs);
+    return stats;
+}
+
+CodecThreadScope::CodecThreadScope(CpuStage stage)
+    : stage_(stage),
+      accounting_(currentAccounting),
+      owner_(currentThread) {
+    if (!accounting_) return;
+    codecOpenMutex().lock();
+    before_ = listThreads();
+}
+
+CodecThreadScope::~CodecThreadScope() {
+    if (!accounting_) return;
+
+    char comm[17] = {};
+    prctl(PR_GET_NAME, comm, 0, 0, 0);
+
+    std::vector<pid_t> adopted;
+    for (pid_t tid : listThreads()) {
+        if (std::binary_search(before_.begin(), before_.end(), tid)) continue;
+        std::string name = threadName(tid);
+        if (name == comm || name.compare(0, 3, "av:") == 0) {
+            adopted.push_back(tid);
+        }
+    }
+    codecOpenMutex().unlock();
+
+    if (!adopted.empty()) {
+        accounting_->adoptWorkers(owner_, stage_, adopted);
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+// CPU time consumed by the calling thread (CLOCK_THREAD_CPUTIME_ID)
+uint64_t threadCpuTimeNs();
+
+enum class CpuStage {
+    Demux,
+    Decode,
+    Convert,
+    Encode,
+    Write,
+    Count
+};
+
+// CPU accounting for one camera. Pipeline threads register themselves,
+// charge the thread CPU time of each stage they run, and sample their own
+// getrusage(RUSAGE_THREAD) about once a second. Codec worker threads, which
+// libavcodec and x264 start inside avcodec_open2(), are adopted through
+// CodecThreadScope by the thread that opens the codec and sampled from
+// /proc/self/task along with it.
+class CpuAccounting {
+public:
+    struct Thread;
+
+    CpuAccounting();
+    ~CpuAccounting();
+
+    CpuAccounting(const CpuAccounting&) = delete;
+    CpuAccounting& operator=(const CpuAccounting&) = delete;
+
+    // Forget the previous session; no pipeline thread may be running
+    void reset();
+
+    // Register the calling thread; it becomes the owner of codec threads
+    // opened under CodecThreadScope
+    Thread* registerThread(const char* name);
+
+    void charge(CpuStage stage, uint64_t ns) {
+        auto& counter = stages_[static_cast<int>(stage)];
+        counter.ns.fetch_add(ns, std::memory_order_relaxed);
+        counter.calls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Charge the calling thread's CPU time since `startNs`; returns the time
+    // now, to start the next stage from
+    uint64_t chargeSince(CpuStage stage, uint64_t startNs) {
+        uint64_t nowNs = threadCpuTimeNs();
+        charge(stage, nowNs - startNs);
+        return nowNs;
+    }
+
+    // Refresh the calling thread's figures and those of its codec workers;
+    // cheap when the last sample is under a second old unless `force`
+    void sample(Thread* thread, bool force = false);
+
+    CpuStats snapshot(const std::string& camera) const;
+
+private:
+    friend class CodecThreadScope;
+
+    struct Usage {
+        uint64_t cpuNs = 0;
+        uint64_t voluntarySwitches = 0;
+        uint64_t involuntarySwitches = 0;
+        uint64_t minorFaults = 0;
+        uint64_t majorFaults = 0;
+
+        void add(const Usage& other);
+    };
+
+    struct Worker {
+        pid_t tid;
+        uint64_t startTime;     // Ticks since boot; tells it apart from a reused id
+        CpuStage stage;
+        Usage usage;            // Last sample
+    };
+
+    struct StageCounter {
+        std::atomic<uint64_t> ns{0};
+        std::atomic<uint64_t> calls{0};
+    };
+
+    void adoptWorkers(Thread* owner, CpuStage stage, const std::vector<pid_t>& tids);
+
+    mutable std::mutex mutex_;
+    std::deque<Thread> threads_;                  // Stable addresses for the owners
+    Usage retiredWorkers_[static_cast<int>(CpuStage::Count)];  // Exited codec threads
+    StageCounter stages_[static_cast<int>(CpuStage::Count)];
+    uint64_t startUs_ = 0;
+};
+
+struct CpuAccounting::Thread {
+    std::string name;
+    Usage usage;                // Guarded by mutex_
+    std::vector<Worker> workers;
+    uint64_t nextSampleUs = 0;  // Owner only
+};
+
+// Charges the calling thread's CPU time from construction to destruction
+class StageCpuTimer {
+public:
+    StageCpuTimer(CpuAccounting& accounting, CpuStage stage)
+        : accounting_(accounting), stage_(stage), startNs_(threadCpuTimeNs()) {}
+    ~StageCpuTimer() { accounting_.chargeSince(stage_, startNs_); }
+
+    StageCpuTimer(const StageCpuTimer&) = delete;
+    StageCpuTimer& operator=(const StageCpuTimer&) = delete;
+
+private:
+    CpuAccounting& accounting_;
+    CpuStage stage_;
+    uint64_t startNs_;
+};
+
+// Attributes the threads a codec starts while this scope is open (inside
+// avcodec_open2) to `stage` of the calling thread's camera. A no-op on
+// threads that did not register with a CpuAccounting. Opens are serialized
+// process-wide, and a new thread is adopted only if it carries the opener's
+// name (which Linux threads inherit) or libavcodec's "av:" prefix, so other
+// cameras starting threads at the same moment are not picked up.
+class CodecThreadScope {
+public:
+    explicit CodecThreadScope(CpuStage stage);
+    ~CodecThreadScope();
+
+    CodecThreadScope(const CodecThreadScope&) = delete;
+    CodecThreadScope& operator=(const CodecThreadScope&) = delete;
+
+private:
+    CpuStage stage_;
+    CpuAccounting* accounting_;
+    CpuAccounting::Thread* owner_;
+    std::vector<pid_t> before_;
+};
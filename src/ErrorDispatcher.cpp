@@ -0,0 +1,175 @@
+#include "ErrorDispatcher.hpp"
+#include "Frame.hpp"
+
+#include <chrono>
+#include <string>
+
+namespace {
+
+constexpr int kWakeIntervalMs = 50;
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::high_resolution_clock::now().time_since_epoch().count());
+}
+
+}  // namespace
+
+ErrorDispatcher::ErrorDispatcher() {
+    for (size_t i = 0; i < kQueueSize; ++i) {
+        cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    thread_ = std::thread(&ErrorDispatcher::dispatchThreadFunc, this);
+}
+
+ErrorDispatcher::~ErrorDispatcher() {
+    stop_.store(true);
+    wakeCv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ErrorDispatcher::setCallback(ErrorCallback callback) {
+    std::shared_ptr<const ErrorCallback> next;
+    if (callback) {
+        next = std::make_shared<const ErrorCallback>(std::move(callback));
+    }
+    std::atomic_store(&callback_, next);
+}
+
+void ErrorDispatcher::post(ErrorInfo&& error) {
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells_[pos & (kQueueSize - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            dropped_.fetch_add(1);  // Full: the dispatch thread is far behind
+            return;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->error = std::move(error);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    wakeCv_.notify_one();
+}
+
+bool ErrorDispatcher::pop(ErrorInfo& error) {
+    Cell& cell = cells_[dequeuePos_ & (kQueueSize - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != dequeuePos_ + 1) {
+        return false;
+    }
+    error = std::move(cell.error);
+    cell.sequence.store(dequeuePos_ + kQueueSize, std::memory_order_release);
+    dequeuePos_++;
+    return true;
+}
+
+void ErrorDispatcher::flush() {
+    // From inside the callback the queue is being drained already
+    if (std::this_thread::get_id() == thread_.get_id()) return;
+
+    uint64_t ticket = flushRequests_.fetch_add(1) + 1;
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    wakeCv_.notify_all();
+    flushedCv_.wait(lock, [&] { return flushesDone_.load() >= ticket || stop_.load(); });
+}
+
+void ErrorDispatcher::dispatch(const ErrorInfo& error) {
+    std::shared_ptr<const ErrorCallback> callback = std::atomic_load(&callback_);
+    if (callback && *callback) {
+        (*callback)(error);
+    }
+}
+
+void ErrorDispatcher::process(ErrorInfo&& error, uint64_t nowUs) {
+    if (error.isFatal) {
+        dispatch(error);
+        return;
+    }
+
+    Key key(error.type, error.message, error.isFatal);
+    auto it = windows_.find(key);
+    if (it == windows_.end()) {
+        // First occurrence opens a window and is delivered right away
+        dispatch(error);
+        windows_.emplace(std::move(key), Window{nowUs, ErrorInfo{error.type, error.message, "",
+                                                                error.timestamp, false, 0,
+                                                                error.timestamp, error.timestamp,
+                                                                ""}});
+        return;
+    }
+
+    ErrorInfo& held = it->second.suppressed;
+    if (held.count == 0) {
+        held.firstTimestamp = error.timestamp;
+        held.firstDetail = error.detail;
+    }
+    held.count++;
+    held.lastTimestamp = error.timestamp;
+    held.timestamp = error.timestamp;
+    held.detail = std::move(error.detail);
+}
+
+void ErrorDispatcher::flushWindows(uint64_t nowUs, bool all) {
+    for (auto it = windows_.begin(); it != windows_.end();) {
+        Window& window = it->second;
+        if (!all && nowUs - window.startUs < kCoalesceWindowUs) {
+            ++it;
+            continue;
+        }
+
+        // A quiet window closes; a busy one reports its repeats and starts over
+        if (window.suppressed.count == 0) {
+            it = windows_.erase(it);
+            continue;
+        }
+        dispatch(window.suppressed);
+        window.suppressed.count = 0;
+        window.startUs = nowUs;
+        if (all) {
+            it = windows_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    uint64_t dropped = dropped_.exchange(0);
+    if (dropped > 0) {
+        uint64_t ns = nowNs();
+        dispatch({ErrorType::Other,
+                  std::to_string(dropped) + " errors dropped (error queue full)", "",
+                  ns, false, dropped, ns, ns, ""});
+    }
+}
+
+void ErrorDispatcher::dispatchThreadFunc() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wakeCv_.wait_for(lock, std::chrono::milliseconds(kWakeIntervalMs));
+        }
+        bool stopping = stop_.load();
+        uint64_t requested = flushRequests_.load();
+
+        ErrorInfo error;
+        while (pop(error)) {
+            process(std::move(error), steadyTimeUs());
+        }
+        bool flushing = stopping || requested > flushesDone_.load();
+        flushWindows(steadyTimeUs(), flushing);
+
+        if (flushing) {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            flushesDone_.store(requested);
+            flushedCv_.notify_all();
+        }
+        if (stopping) break;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+
+// Delivers errors to the user callback on its own thread. Pipeline threads
+// only push into a bounded lock-free queue, so a slow callback can never
+// stall capture. Repeats of the same error (type, message, fatality) within
+// one window are coalesced: the first is delivered at once, the rest as a
+// single report per window carrying their count and first/last timestamps
+// and details. Messages are fixed text; the varying part (a path) travels in
+// `detail` so it does not split the window.
+// Fatal errors are never coalesced.
+class ErrorDispatcher {
+public:
+    ErrorDispatcher();
+    ~ErrorDispatcher();
+
+    ErrorDispatcher(const ErrorDispatcher&) = delete;
+    ErrorDispatcher& operator=(const ErrorDispatcher&) = delete;
+
+    // Safe to call from any thread at any time
+    void setCallback(ErrorCallback callback);
+
+    // Never blocks; drops (and later reports the number of) errors when the
+    // queue is full
+    void post(ErrorInfo&& error);
+
+    // Deliver everything queued or coalesced so far before returning
+    void flush();
+
+private:
+    static constexpr size_t kQueueSize = 256;          // Power of two
+    static constexpr uint64_t kCoalesceWindowUs = 1000000;
+
+    // Bounded multi-producer queue cell (Vyukov): `sequence` says whether the
+    // cell is free for the producer at that position or holds an entry
+    struct Cell {
+        std::atomic<size_t> sequence;
+        ErrorInfo error;
+    };
+
+    using Key = std::tuple<ErrorType, std::string, bool>;
+    struct Window {
+        uint64_t startUs;
+        ErrorInfo suppressed;         // count 0: nothing held back yet
+    };
+
+    bool pop(ErrorInfo& error);
+    void process(ErrorInfo&& error, uint64_t nowUs);
+    void flushWindows(uint64_t nowUs, bool all);
+    void dispatch(const ErrorInfo& error);
+    void dispatchThreadFunc();
+
+    Cell cells_[kQueueSize];
+    std::atomic<size_t> enqueuePos_{0};
+    size_t dequeuePos_ = 0;                     // Dispatch thread only
+    std::atomic<uint64_t> dropped_{0};
+
+    std::shared_ptr<const ErrorCallback> callback_;   // Swapped with std::atomic_store
+    std::map<Key, Window> windows_;                   // Dispatch thread only
+
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    std::atomic<uint64_t> flushRequests_{0};
+    std::atomic<uint64_t> flushesDone_{0};
+    std::condition_variable flushedCv_;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
@@ -0,0 +1,174 @@
+#include "FileOutput.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Write all of data to fd, retrying short writes and EINTR
+bool writeAll(int fd, const uint8_t* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = write(fd, data + written, size - written);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+bool closePreservingErrno(int fd, bool ok) {
+    int savedErrno = errno;
+    bool closed = close(fd) == 0;
+    if (!ok) errno = savedErrno;
+    return ok && closed;
+}
+
+// Hidden name next to the final file; only needs to be unique in this process
+// at a time, since it is renamed or unlinked right away
+std::string hiddenTempPath(const std::string& folder) {
+    static std::atomic<uint64_t> counter{0};
+    return folder + "/.publish-" + std::to_string(getpid()) + "-" +
+           std::to_string(counter.fetch_add(1));
+}
+
+// Name an O_TMPFILE inode. AT_EMPTY_PATH needs CAP_DAC_READ_SEARCH on most
+// kernels; the /proc link needs no privileges but does need /proc.
+bool linkAnonymous(int fd, const std::string& path) {
+#ifdef AT_EMPTY_PATH
+    if (linkat(fd, "", AT_FDCWD, path.c_str(), AT_EMPTY_PATH) == 0) return true;
+    if (errno == EEXIST) return false;
+#endif
+    std::string procPath = "/proc/self/fd/" + std::to_string(fd);
+    return linkat(AT_FDCWD, procPath.c_str(), AT_FDCWD, path.c_str(), AT_SYMLINK_FOLLOW) == 0;
+}
+
+// Copy the contents of fd into a new file at path; nothing is left on failure
+bool copyToNewFile(int fd, const std::string& path) {
+    int out = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (out < 0) return false;
+    uint8_t buffer[65536];
+    off_t offset = 0;
+    bool ok = true;
+    while (ok) {
+        ssize_t got = pread(fd, buffer, sizeof(buffer), offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) {
+            ok = got == 0;
+            break;
+        }
+        ok = writeAll(out, buffer, static_cast<size_t>(got));
+        offset += got;
+    }
+    ok = closePreservingErrno(out, ok);
+    if (!ok) {
+        int savedErrno = errno;
+        unlink(path.c_str());
+        errno = savedErrno;
+    }
+    return ok;
+}
+
+std::string parentFolder(const std::string& filepath) {
+    size_t slash = filepath.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return filepath.substr(0, slash);
+}
+
+}  // namespace
+
+bool writeFileContents(const std::string& filepath, const uint8_t* data, size_t size) {
+    int fd = open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = writeAll(fd, data, size);
+    return closePreservingErrno(fd, ok);
+}
+
+UnpublishedFile::~UnpublishedFile() {
+    discard();
+}
+
+void UnpublishedFile::discard() {
+    int savedErrno = errno;
+    if (fd_ >= 0) {
+        close(fd_);  // An unlinked O_TMPFILE inode is freed with its last fd
+        fd_ = -1;
+    }
+    if (!tempPath_.empty()) {
+        unlink(tempPath_.c_str());
+        tempPath_.clear();
+    }
+    errno = savedErrno;
+}
+
+bool UnpublishedFile::write(const std::string& folder, const uint8_t* data, size_t size) {
+    discard();
+
+#ifdef O_TMPFILE
+    fd_ = open(folder.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0644);  // Readable for the copy fallback
+    if (fd_ >= 0) {
+        if (writeAll(fd_, data, size)) return true;
+        discard();
+        return false;
+    }
+    // Kernels or filesystems without O_TMPFILE report one of these
+    if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL) {
+        return false;
+    }
+#endif
+
+    tempPath_ = hiddenTempPath(folder);
+    int fd = open(tempPath_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        tempPath_.clear();
+        return false;
+    }
+    bool ok = closePreservingErrno(fd, writeAll(fd, data, size));
+    if (!ok) discard();
+    return ok;
+}
+
+bool UnpublishedFile::publish(const std::string& path) {
+    if (fd_ >= 0) {
+        if (linkAnonymous(fd_, path)) {
+            discard();
+            return true;
+        }
+
+        // linkat never replaces; link under a hidden name and rename over the
+        // old file. Without /proc or the privilege for AT_EMPTY_PATH the inode
+        // cannot be linked at all, so its contents are copied instead.
+        std::string temp = hiddenTempPath(parentFolder(path));
+        bool linked = errno == EEXIST && linkAnonymous(fd_, temp);
+        if (!linked && !copyToNewFile(fd_, temp)) {
+            return false;
+        }
+        tempPath_ = temp;
+        close(fd_);
+        fd_ = -1;
+    }
+
+    if (tempPath_.empty()) {
+        errno = EBADF;
+        return false;
+    }
+    if (std::rename(tempPath_.c_str(), path.c_str()) != 0) {
+        return false;
+    }
+    tempPath_.clear();
+    return true;
+}
+
+bool publishFileContents(const std::string& filepath, const uint8_t* data, size_t size) {
+    UnpublishedFile file;
+    return file.write(parentFolder(filepath), data, size) && file.publish(filepath);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Write a complete buffer to a new file (created or truncated).
+// Returns false on failure with errno set.
+bool writeFileContents(const std::string& filepath, const uint8_t* data, size_t size);
+
+// A file that is written without a visible name and then published under its
+// final name in one step, so readers never see it half-written. Uses an
+// anonymous O_TMPFILE inode and linkat() where the filesystem supports it,
+// otherwise a hidden ".publish-XXXXXX" temp file and rename(). An inode that
+// cannot be linked (no /proc and no AT_EMPTY_PATH privilege) is copied to
+// such a temp file instead. Functions
+// return false on failure with errno set; an unpublished file is discarded
+// by the destructor.
+class UnpublishedFile {
+public:
+    UnpublishedFile() = default;
+    ~UnpublishedFile();
+
+    UnpublishedFile(const UnpublishedFile&) = delete;
+    UnpublishedFile& operator=(const UnpublishedFile&) = delete;
+
+    // Write the complete contents; `folder` must be where publish() will put it
+    bool write(const std::string& folder, const uint8_t* data, size_t size);
+
+    // Give the written file its final path, replacing any file already there
+    bool publish(const std::string& path);
+
+private:
+    void discard();
+
+    int fd_ = -1;               // O_TMPFILE inode, open until published
+    std::string tempPath_;      // Fallback hidden temp file
+};
+
+// Write and publish in one call
+bool publishFileContents(const std::string& filepath, const uint8_t* data, size_t size);
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct FrameKernels;
+
+// Frame data structure for queue
+struct Frame {
+    std::vector<uint8_t> data;
+    FrameFormat format = FrameFormat::Rgb24;
+    int width;
+    int height;
+    uint64_t frameNumber;
+    uint64_t computerTimeMs;      // Computer receive time in milliseconds (when frame decoded)
+    uint64_t computerTimeUs = 0;  // Same instant in microseconds since epoch
+    uint64_t packetTimeUs = 0;    // Wall-clock time the frame's packet was demuxed (0 if unknown)
+    uint64_t hardwareTimeNs;      // Hardware timestamp in nanoseconds
+    bool hwTimeValid;             // True if hardware time is from PTS, false if fallback
+    uint64_t queuedTimeUs = 0;    // Steady-clock time when pushed to the write queue
+    std::vector<uint8_t> sei;     // SEI records, see appendSeiRecord (empty if none)
+    const FrameKernels* kernels = nullptr;  // Session convert/encode kernels (null: generic)
+};
+
+// Plane pointers into Frame::data for raw (non-JPEG) formats
+struct FramePlanes {
+    const uint8_t* data[3];
+    int linesize[3];
+    int count;
+    int chromaWidth;
+    int chromaHeight;
+};
+
+inline FramePlanes framePlanes(FrameFormat format, const uint8_t* base, int width, int height) {
+    FramePlanes planes{};
+    if (format == FrameFormat::Rgb24 || format == FrameFormat::Gray8) {
+        planes.data[0] = base;
+        planes.linesize[0] = format == FrameFormat::Rgb24 ? width * 3 : width;
+        planes.count = 1;
+        return planes;
+    }
+
+    planes.chromaWidth = (width + 1) / 2;
+    planes.chromaHeight = format == FrameFormat::Yuv420 ? (height + 1) / 2 : height;
+    planes.data[0] = base;
+    planes.data[1] = base + static_cast<size_t>(width) * height;
+    planes.data[2] = planes.data[1] + static_cast<size_t>(planes.chromaWidth) * planes.chromaHeight;
+    planes.linesize[0] = width;
+    planes.linesize[1] = planes.chromaWidth;
+    planes.linesize[2] = planes.chromaWidth;
+    planes.count = 3;
+    return planes;
+}
+
+inline FramePlanes framePlanes(const Frame& frame) {
+    return framePlanes(frame.format, frame.data.data(), frame.width, frame.height);
+}
+
+// Bytes of Frame::data for a raw format
+inline size_t frameDataSize(FrameFormat format, int width, int height) {
+    size_t luma = static_cast<size_t>(width) * height;
+    switch (format) {
+        case FrameFormat::Rgb24:  return luma * 3;
+        case FrameFormat::Yuv420: return luma + 2 * static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        case FrameFormat::Yuv422: return luma + 2 * static_cast<size_t>((width + 1) / 2) * height;
+        case FrameFormat::Gray8:  return luma;
+        default:                  return 0;
+    }
+}
+
+// SEI payload types carried in Frame::sei
+enum SeiPayloadType : uint8_t {
+    SeiRegisteredItuT35 = 4,      // user_data_registered_itu_t_t35, A/53 cc_data as exported by the decoder
+    SeiUnregistered = 5           // user_data_unregistered: 16-byte UUID + payload
+};
+
+// Append one SEI record in compact binary form: [type u8][size u16 LE][payload].
+// Payloads over 64 KiB are truncated.
+inline void appendSeiRecord(std::vector<uint8_t>& sei, uint8_t type,
+                            const uint8_t* payload, size_t size) {
+    size_t length = size > 0xFFFF ? 0xFFFF : size;
+    sei.push_back(type);
+    sei.push_back(static_cast<uint8_t>(length & 0xFF));
+    sei.push_back(static_cast<uint8_t>(length >> 8));
+    sei.insert(sei.end(), payload, payload + length);
+}
+
+// Per-frame write-path stage timings in microseconds
+struct FrameTiming {
+    uint64_t queueWaitUs = 0;     // Time spent in the write queue
+    uint64_t encodeUs = 0;        // JPEG encode (0 for passthrough)
+    uint64_t writeUs = 0;         // File write + publish
+
+    uint64_t latencyUs() const { return encodeUs + writeUs; }
+};
+
+// Wall-clock microseconds since epoch (comparable across threads and with file times)
+inline uint64_t systemTimeUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Steady-clock microseconds (for stage timing, not wall-clock)
+inline uint64_t steadyTimeUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Format computer time as YYYY.MM.DD_HH.MM.SS.mmm
+inline std::string formatComputerTime(uint64_t computerTimeMs) {
+    time_t seconds = computerTimeMs / 1000;
+    uint64_t milliseconds = computerTimeMs % 1000;
+    struct tm timeinfo;
+    localtime_r(&seconds, &timeinfo);
+
+    std::ostringstream timeStr;
+    timeStr << std::setfill('0')
+            << (timeinfo.tm_year + 1900) << "."
+            << std::setw(2) << (timeinfo.tm_mon + 1) << "."
+            << std::setw(2) << timeinfo.tm_mday << "_"
+            << std::setw(2) << timeinfo.tm_hour << "."
+            << std::setw(2) << timeinfo.tm_min << "."
+            << std::setw(2) << timeinfo.tm_sec << "."
+            << std::setw(3) << milliseconds;
+    return timeStr.str();
+}
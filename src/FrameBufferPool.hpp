@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Recycles Frame::data buffers between the capture thread and the writers.
+// Buffers keep their size, so a convert into a same-sized frame neither
+// allocates nor zero-fills.
+class FrameBufferPool {
+public:
+    explicit FrameBufferPool(size_t maxBuffers) : maxBuffers_(maxBuffers) {}
+
+    // A previously used buffer, or an empty one when the pool is dry
+    std::vector<uint8_t> acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffers_.empty()) return {};
+        std::vector<uint8_t> buffer = std::move(buffers_.back());
+        buffers_.pop_back();
+        return buffer;
+    }
+
+    // Hand a buffer back; leaves it empty. Extra buffers beyond the cap are freed.
+    void release(std::vector<uint8_t>& buffer) {
+        if (buffer.capacity() == 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (buffers_.size() < maxBuffers_) {
+            buffers_.push_back(std::move(buffer));
+        }
+        buffer = {};
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.clear();
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::vector<uint8_t>> buffers_;
+    const size_t maxBuffers_;
+};
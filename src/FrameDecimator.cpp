@@ -0,0 +1,74 @@
+#include "FrameDecimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+FrameDecimator::FrameDecimator(double outputFps)
+    : periodUs_(std::max<int64_t>(1, std::llround(1e6 / outputFps))) {
+}
+
+void FrameDecimator::recordSelection(int64_t timeUs, int64_t targetUs) {
+    uint64_t jitter = static_cast<uint64_t>(std::llabs(timeUs - targetUs));
+    stats_.selected++;
+    stats_.jitterSumUs += jitter;
+    stats_.maxJitterUs = std::max(stats_.maxJitterUs, jitter);
+}
+
+FrameDecimator::Decision FrameDecimator::offer(int64_t timeUs) {
+    Decision decision;
+
+    if (started_ && (timeUs < nextTargetUs_ - periodUs_ || timeUs > nextTargetUs_ + kMaxGapUs)) {
+        discardHeld();
+        started_ = false;
+        stats_.resets++;
+    }
+
+    // Slots sit on multiples of the period, so host-time output lands on
+    // wall-clock boundaries (e.g. .000, .100, .200 s at 10 fps)
+    if (!started_) {
+        nextTargetUs_ = (timeUs + periodUs_ - 1) / periodUs_ * periodUs_;
+        started_ = true;
+    }
+
+    while (timeUs >= nextTargetUs_) {
+        // Held frame (before the slot) against this one (at or after it)
+        if (hasHeld_) {
+            hasHeld_ = false;
+            if (nextTargetUs_ - heldUs_ <= timeUs - nextTargetUs_) {
+                decision.emitHeld = true;
+                decision.heldTargetUs = nextTargetUs_;
+                recordSelection(heldUs_, nextTargetUs_);
+                nextTargetUs_ += periodUs_;
+                continue;
+            }
+            stats_.dropped++;
+        }
+
+        // This frame is nearest to the last slot it passed; earlier ones had no frame
+        while (timeUs >= nextTargetUs_ + periodUs_) {
+            stats_.missedSlots++;
+            nextTargetUs_ += periodUs_;
+        }
+        decision.emitCurrent = true;
+        decision.currentTargetUs = nextTargetUs_;
+        recordSelection(timeUs, nextTargetUs_);
+        nextTargetUs_ += periodUs_;
+        return decision;
+    }
+
+    // Before the next slot: becomes the candidate, replacing an older one
+    if (hasHeld_) {
+        stats_.dropped++;
+    }
+    hasHeld_ = true;
+    heldUs_ = timeUs;
+    decision.holdCurrent = true;
+    return decision;
+}
+
+void FrameDecimator::discardHeld() {
+    if (hasHeld_) {
+        stats_.dropped++;
+        hasHeld_ = false;
+    }
+}
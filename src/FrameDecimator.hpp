@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+// Picks, for every slot k * period on a fixed output grid, the input frame
+// whose timestamp is nearest to it. Deciding "nearest" needs one frame of
+// lookahead: a frame just before a slot is held until the next frame shows
+// whether it or the held one is closer. Works on timestamps only; the caller
+// keeps the pictures.
+class FrameDecimator {
+public:
+    struct Decision {
+        bool emitHeld = false;      // The held frame fills heldTargetUs
+        bool emitCurrent = false;   // The offered frame fills currentTargetUs
+        bool holdCurrent = false;   // Keep the offered frame as the next candidate
+        int64_t heldTargetUs = 0;
+        int64_t currentTargetUs = 0;
+    };
+
+    struct Stats {
+        uint64_t selected = 0;      // Frames emitted
+        uint64_t dropped = 0;       // Frames discarded
+        uint64_t missedSlots = 0;   // Slots with no frame of their own (input gaps)
+        uint64_t jitterSumUs = 0;   // Sum of |frame time - slot time| over selected frames
+        uint64_t maxJitterUs = 0;
+        uint64_t resets = 0;        // Grid re-anchored after a timestamp jump
+    };
+
+    explicit FrameDecimator(double outputFps);
+
+    // Offer the next input frame's timestamp (microseconds, increasing). A
+    // step back of more than a period, or forward past kMaxGapUs, is taken as
+    // a clock discontinuity (camera reboot, PTS wrap, host clock step): the
+    // held frame is dropped and the grid starts over from this frame.
+    Decision offer(int64_t timeUs);
+
+    // Forget the held frame (stream reset, format change)
+    void discardHeld();
+
+    bool hasHeld() const { return hasHeld_; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    // Longer input gaps re-anchor instead of counting every missed slot
+    static constexpr int64_t kMaxGapUs = 10000000;
+
+    void recordSelection(int64_t timeUs, int64_t targetUs);
+
+    int64_t periodUs_;
+    int64_t nextTargetUs_ = 0;
+    bool started_ = false;
+    bool hasHeld_ = false;
+    int64_t heldUs_ = 0;
+    Stats stats_;
+};
@@ -0,0 +1,102 @@
+#include "FrameIndex.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static const char* kIndexHeader =
+    "session,frame_number,computer_time_ms,hw_time_ns,hw_valid,latency_ms,"
+    "queue_wait_us,encode_us,write_us,packet_time_us,receive_time_us,commit_time_us,"
+    "bytes,file,container_pts,container_offset,segment_frame,sei_hex,"
+    "luma_mean,luma_variance,sharpness,luma_hist,root\n";
+
+FrameIndex::FrameIndex(const std::string& outputFolder)
+    : path_(outputFolder + "/index.csv"),
+      sessionId_(systemTimeUs()) {
+    // Append across sessions, but only below a matching header. An index
+    // with other columns (older release) moves aside to index.<n>.csv.
+    if (FILE* existing = fopen(path_.c_str(), "r")) {
+        char header[1024] = "";
+        bool empty = !fgets(header, sizeof(header), existing);
+        fclose(existing);
+        if (!empty && strcmp(header, kIndexHeader) != 0) {
+            std::string aside;
+            for (int n = 1; aside.empty() || fs::exists(aside); ++n) {
+                aside = outputFolder + "/index." + std::to_string(n) + ".csv";
+            }
+            if (rename(path_.c_str(), aside.c_str()) != 0) {
+                return;  // Not open: rows must never land under a foreign header
+            }
+        }
+    }
+
+    file_ = fopen(path_.c_str(), "a");
+    if (file_ && ftell(file_) == 0) {
+        fputs(kIndexHeader, file_);
+    }
+}
+
+FrameIndex::~FrameIndex() {
+    if (file_) fclose(file_);
+}
+
+void FrameIndex::append(const IndexRecord& record) {
+    if (!file_) return;
+
+    // Hex-encode SEI outside the lock
+    static const char kHexDigits[] = "0123456789abcdef";
+    std::string seiHex;
+    seiHex.reserve(record.sei.size() * 2);
+    for (uint8_t byte : record.sei) {
+        seiHex.push_back(kHexDigits[byte >> 4]);
+        seiHex.push_back(kHexDigits[byte & 0x0F]);
+    }
+
+    // Histogram bins are ';'-separated so the row stays one CSV field per column
+    char statsText[256] = "";
+    const ImageStats& stats = record.imageStats;
+    if (stats.valid) {
+        int length = snprintf(statsText, sizeof(statsText), "%.2f,%.2f,%.2f,",
+                              stats.lumaMean, stats.lumaVariance, stats.sharpness);
+        for (int bin = 0; bin < kHistogramBins; ++bin) {
+            length += snprintf(statsText + length, sizeof(statsText) - length,
+                               bin ? ";%u" : "%u", stats.histogramPermille[bin]);
+        }
+    } else {
+        snprintf(statsText, sizeof(statsText), ",,,");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    fprintf(file_, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+            ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%s,%" PRId64 ",%" PRId64 ",%" PRId64 ",%s,%s,%s\n",
+            sessionId_,
+            record.frameNumber,
+            record.computerTimeMs,
+            record.hardwareTimeNs,
+            record.hwTimeValid ? 1 : 0,
+            record.latencyMs,
+            record.timing.queueWaitUs,
+            record.timing.encodeUs,
+            record.timing.writeUs,
+            record.packetTimeUs,
+            record.receiveTimeUs,
+            record.commitTimeUs,
+            record.bytes,
+            record.file.c_str(),
+            record.containerPts,
+            record.containerOffset,
+            record.segmentFrame,
+            seiHex.c_str(),
+            statsText,
+            record.root.c_str());
+}
+
+void FrameIndex::flush() {
+    if (!file_) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    fflush(file_);
+}
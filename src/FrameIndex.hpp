@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Frame.hpp"
+#include "ImageStats.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One row of the per-session frame index
+struct IndexRecord {
+    uint64_t frameNumber;
+    uint64_t computerTimeMs;
+    uint64_t hardwareTimeNs;
+    bool hwTimeValid;
+    uint64_t latencyMs;           // Encode + write time (0 for passthrough)
+    FrameTiming timing;           // Microsecond stage timings
+    uint64_t packetTimeUs;        // Wall-clock times (us since epoch): packet demuxed,
+    uint64_t receiveTimeUs;       //   frame decoded,
+    uint64_t commitTimeUs;        //   frame visible on disk
+    uint64_t bytes;               // Encoded frame size
+    std::string file;             // File containing the frame (relative to output folder)
+    int64_t containerPts;         // Timestamp inside a container file (-1 for stills)
+    int64_t containerOffset;      // Container write position before the frame was muxed (-1 for stills)
+    int64_t segmentFrame;         // Position of the frame in its segment file, from 0 (-1 for stills)
+    std::vector<uint8_t> sei;     // Frame::sei records, written as hex
+    ImageStats imageStats;        // Luma statistics (columns left empty when not computed)
+    std::string root;             // Output root holding `file` when striping (empty otherwise)
+};
+
+// Thread-safe CSV index of written frames (index.csv in the output folder).
+// Sessions append to the same file; the session column tells them apart,
+// since frame numbers restart with every session.
+class FrameIndex {
+public:
+    explicit FrameIndex(const std::string& outputFolder);
+    ~FrameIndex();
+
+    FrameIndex(const FrameIndex&) = delete;
+    FrameIndex& operator=(const FrameIndex&) = delete;
+
+    bool isOpen() const { return file_ != nullptr; }
+    const std::string& path() const { return path_; }
+    uint64_t sessionId() const { return sessionId_; }
+
+    void append(const IndexRecord& record);
+    void flush();
+
+private:
+    std::string path_;
+    uint64_t sessionId_;          // System time (us since epoch) the index was opened
+    FILE* file_ = nullptr;
+    std::mutex mutex_;
+};
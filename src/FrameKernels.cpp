@@ -0,0 +1,242 @@
+#include "FrameKernels.hpp"
+#include "JpegEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+
+// Limited (MPEG) to full (JPEG) range lookup tables
+struct RangeTables {
+    uint8_t luma[256];
+    uint8_t chroma[256];
+
+    RangeTables() {
+        for (int v = 0; v < 256; ++v) {
+            int y = ((v - 16) * 255 + 109) / 219;
+            int c = ((v - 128) * 255 + (v >= 128 ? 112 : -112)) / 224 + 128;
+            luma[v] = static_cast<uint8_t>(std::clamp(y, 0, 255));
+            chroma[v] = static_cast<uint8_t>(std::clamp(c, 0, 255));
+        }
+    }
+};
+
+const RangeTables& rangeTables() {
+    static const RangeTables tables;
+    return tables;
+}
+
+template <int Width, bool LimitedRange>
+inline void copyPlaneRows(uint8_t* dst, const uint8_t* src, int srcStride,
+                          int width, int rows, const uint8_t* lut) {
+    const int w = Width ? Width : width;
+    for (int y = 0; y < rows; ++y) {
+        const uint8_t* in = src + static_cast<size_t>(y) * srcStride;
+        uint8_t* out = dst + static_cast<size_t>(y) * w;
+        if (LimitedRange) {
+            for (int x = 0; x < w; ++x) out[x] = lut[in[x]];
+        } else {
+            memcpy(out, in, w);
+        }
+    }
+}
+
+// Copy Y/Cb/Cr planes into a tightly packed full-range frame
+template <int ChromaRowShift, bool LimitedRange, int FixedWidth, int FixedHeight>
+bool convertPlanar(const AVFrame* src, Frame& dst, ConvertScratch&) {
+    const int width = FixedWidth ? FixedWidth : src->width;
+    const int height = FixedHeight ? FixedHeight : src->height;
+    const int chromaWidth = width / 2;
+    const int chromaHeight = (height + ChromaRowShift) >> ChromaRowShift;
+    const FrameFormat format = ChromaRowShift ? FrameFormat::Yuv420 : FrameFormat::Yuv422;
+
+    dst.format = format;
+    dst.width = width;
+    dst.height = height;
+    dst.data.resize(frameDataSize(format, width, height));
+
+    const RangeTables& tables = rangeTables();
+    uint8_t* yPlane = dst.data.data();
+    uint8_t* cbPlane = yPlane + static_cast<size_t>(width) * height;
+    uint8_t* crPlane = cbPlane + static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    copyPlaneRows<FixedWidth, LimitedRange>(yPlane, src->data[0], src->linesize[0],
+                                            width, height, tables.luma);
+    copyPlaneRows<FixedWidth / 2, LimitedRange>(cbPlane, src->data[1], src->linesize[1],
+                                                chromaWidth, chromaHeight, tables.chroma);
+    copyPlaneRows<FixedWidth / 2, LimitedRange>(crPlane, src->data[2], src->linesize[2],
+                                                chromaWidth, chromaHeight, tables.chroma);
+    return true;
+}
+
+// Fallback for any format: sws_scale straight into the frame as RGB24
+bool convertGeneric(const AVFrame* src, Frame& dst, ConvertScratch& scratch) {
+    // sws_getCachedContext frees the old context itself when it cannot reuse it
+    scratch.swsCtx.reset(sws_getCachedContext(scratch.swsCtx.release(),
+        src->width, src->height, static_cast<AVPixelFormat>(src->format),
+        src->width, src->height, AV_PIX_FMT_RGB24,
+        SWS_FAST_BILINEAR, nullptr, nullptr, nullptr));
+    if (!scratch.swsCtx) return false;
+
+    dst.format = FrameFormat::Rgb24;
+    dst.width = src->width;
+    dst.height = src->height;
+    dst.data.resize(frameDataSize(FrameFormat::Rgb24, src->width, src->height));
+
+    uint8_t* dstData[1] = {dst.data.data()};
+    int dstLinesize[1] = {src->width * 3};
+    sws_scale(scratch.swsCtx.get(), src->data, src->linesize, 0, src->height, dstData, dstLinesize);
+    return true;
+}
+
+// Grayscale: take the decoder's luma plane, leave chroma untouched
+template <bool LimitedRange>
+bool convertLuma(const AVFrame* src, Frame& dst, ConvertScratch&) {
+    dst.format = FrameFormat::Gray8;
+    dst.width = src->width;
+    dst.height = src->height;
+    dst.data.resize(frameDataSize(FrameFormat::Gray8, src->width, src->height));
+
+    copyPlaneRows<0, LimitedRange>(dst.data.data(), src->data[0], src->linesize[0],
+                                   src->width, src->height, rangeTables().luma);
+    return true;
+}
+
+// Grayscale for packed or RGB inputs: sws_scale to GRAY8
+bool convertGenericGray(const AVFrame* src, Frame& dst, ConvertScratch& scratch) {
+    scratch.swsCtx.reset(sws_getCachedContext(scratch.swsCtx.release(),
+        src->width, src->height, static_cast<AVPixelFormat>(src->format),
+        src->width, src->height, AV_PIX_FMT_GRAY8,
+        SWS_FAST_BILINEAR, nullptr, nullptr, nullptr));
+    if (!scratch.swsCtx) return false;
+
+    dst.format = FrameFormat::Gray8;
+    dst.width = src->width;
+    dst.height = src->height;
+    dst.data.resize(frameDataSize(FrameFormat::Gray8, src->width, src->height));
+
+    uint8_t* dstData[1] = {dst.data.data()};
+    int dstLinesize[1] = {src->width};
+    sws_scale(scratch.swsCtx.get(), src->data, src->linesize, 0, src->height, dstData, dstLinesize);
+    return true;
+}
+
+template <int ChromaRowShift, bool LimitedRange, int FixedWidth, int FixedHeight>
+constexpr FrameKernels planarKernels(const char* name) {
+    return {
+        name,
+        ChromaRowShift ? FrameFormat::Yuv420 : FrameFormat::Yuv422,
+        convertPlanar<ChromaRowShift, LimitedRange, FixedWidth, FixedHeight>,
+        encodePlanarJPEG<ChromaRowShift, FixedWidth, FixedHeight>
+    };
+}
+
+const FrameKernels kGenericKernels = {
+    "generic (sws RGB24)", FrameFormat::Rgb24, convertGeneric, encodeFrameToJPEG
+};
+
+// Luma-plane kernels: [limited range?]
+const FrameKernels kLumaKernels[2] = {
+    {"gray (luma plane) full", FrameFormat::Gray8, convertLuma<false>, encodeGrayJPEG},
+    {"gray (luma plane) limited", FrameFormat::Gray8, convertLuma<true>, encodeGrayJPEG},
+};
+
+const FrameKernels kGenericGrayKernels = {
+    "gray (sws GRAY8)", FrameFormat::Gray8, convertGenericGray, encodeGrayJPEG
+};
+
+// Runtime-dimension planar kernels: [chroma 4:2:0?][limited range?]
+const FrameKernels kPlanarKernels[2][2] = {
+    {planarKernels<0, false, 0, 0>("planar 4:2:2 full"),
+     planarKernels<0, true, 0, 0>("planar 4:2:2 limited")},
+    {planarKernels<1, false, 0, 0>("planar 4:2:0 full"),
+     planarKernels<1, true, 0, 0>("planar 4:2:0 limited")},
+};
+
+// Known FLIR M300 modes
+struct SpecializedMode {
+    int width;
+    int height;
+    bool chroma420;
+    bool limitedRange;
+    FrameKernels kernels;
+};
+
+const SpecializedMode kSpecializedModes[] = {
+    {1920, 1080, true, true, planarKernels<1, true, 1920, 1080>("1920x1080 4:2:0 limited")},
+    {1920, 1080, true, false, planarKernels<1, false, 1920, 1080>("1920x1080 4:2:0 full")},
+    {1280, 720, false, false, planarKernels<0, false, 1280, 720>("1280x720 4:2:2 full")},
+    {1280, 720, false, true, planarKernels<0, true, 1280, 720>("1280x720 4:2:2 limited")},
+};
+
+}  // namespace
+
+const FrameKernels& selectFrameKernels(int width, int height, int pixFmt, bool fullRange,
+                                       KernelTier maxTier) {
+    bool chroma420;
+    bool limitedRange;
+    switch (pixFmt) {
+        case AV_PIX_FMT_YUV420P:  chroma420 = true;  limitedRange = !fullRange; break;
+        case AV_PIX_FMT_YUVJ420P: chroma420 = true;  limitedRange = false; break;
+        case AV_PIX_FMT_YUV422P:  chroma420 = false; limitedRange = !fullRange; break;
+        case AV_PIX_FMT_YUVJ422P: chroma420 = false; limitedRange = false; break;
+        default:                  return kGenericKernels;
+    }
+
+    // Raw JPEG input reads whole MCUs per row
+    if (maxTier == KernelTier::Generic || width % 16 != 0 || height < 2) {
+        return kGenericKernels;
+    }
+
+    if (maxTier == KernelTier::Specialized) {
+        for (const SpecializedMode& mode : kSpecializedModes) {
+            if (mode.width == width && mode.height == height &&
+                mode.chroma420 == chroma420 && mode.limitedRange == limitedRange) {
+                return mode.kernels;
+            }
+        }
+    }
+
+    return kPlanarKernels[chroma420 ? 1 : 0][limitedRange ? 1 : 0];
+}
+
+const FrameKernels& selectGrayKernels(int pixFmt, bool fullRange) {
+    switch (pixFmt) {
+        // Planar and semi-planar YUV: data[0] is the Y plane
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_NV12:
+            return kLumaKernels[fullRange ? 0 : 1];
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_GRAY8:
+            return kLumaKernels[0];
+        default:
+            return kGenericGrayKernels;
+    }
+}
+
+EncodeFn encoderForFormat(FrameFormat format) {
+    switch (format) {
+        case FrameFormat::Rgb24:  return encodeFrameToJPEG;
+        case FrameFormat::Yuv420: return encodePlanarJPEG<1>;
+        case FrameFormat::Yuv422: return encodePlanarJPEG<0>;
+        case FrameFormat::Gray8:  return encodeGrayJPEG;
+        default:                  return nullptr;
+    }
+}
+
+bool encodeFrame(const Frame& frame, int quality, std::vector<uint8_t>& jpeg) {
+    if (frame.kernels) {
+        return frame.kernels->encode(frame, quality, jpeg);
+    }
+    return encodeFrameToJPEG(frame, quality, jpeg);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Frame.hpp"
+#include "FFmpegHandles.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Per-session state for convert kernels that need it (generic sws path)
+struct ConvertScratch {
+    SwsContextPtr swsCtx;
+};
+
+// Convert a decoded picture into Frame::data (sets format/width/height)
+using ConvertFn = bool (*)(const AVFrame* src, Frame& dst, ConvertScratch& scratch);
+
+// Encode Frame::data to JPEG in memory
+using EncodeFn = bool (*)(const Frame& frame, int quality, std::vector<uint8_t>& jpeg);
+
+// Convert + encode pair for one stream mode, chosen once per session
+struct FrameKernels {
+    const char* name;
+    FrameFormat format;
+    ConvertFn convert;
+    EncodeFn encode;
+};
+
+// How specialized a kernel selection may be (used by benchmarks to compare)
+enum class KernelTier {
+    Generic,        // sws_scale to RGB24 + RGB JPEG encode
+    Planar,         // Templated planar copy + raw YCbCr encode, runtime dimensions
+    Specialized     // Planar kernels compiled for a known FLIR mode
+};
+
+// Pick the most specialized kernels for a stream mode, up to maxTier.
+// pixFmt is an AVPixelFormat; fullRange is true for JPEG-range YUV.
+const FrameKernels& selectFrameKernels(int width, int height, int pixFmt, bool fullRange,
+                                       KernelTier maxTier = KernelTier::Specialized);
+
+// Grayscale kernels: copy the luma plane (expanding limited range) and encode a
+// single-component JPEG. Non-YUV formats go through sws to GRAY8.
+const FrameKernels& selectGrayKernels(int pixFmt, bool fullRange);
+
+// Runtime-dimension encoder for a raw frame format (for frames assembled
+// outside a session, e.g. composites). Null for Jpeg.
+EncodeFn encoderForFormat(FrameFormat format);
+
+// Encode with the frame's session kernels (RGB24 encoder when unset)
+bool encodeFrame(const Frame& frame, int quality, std::vector<uint8_t>& jpeg);
@@ -0,0 +1,65 @@
+#include "FrameNotifier.hpp"
+#include "Frame.hpp"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+FrameNotifier::FrameNotifier(const std::string& socketPath)
+    : socketPath_(socketPath) {
+}
+
+FrameNotifier::~FrameNotifier() {
+    if (fd_ >= 0) close(fd_);
+}
+
+bool FrameNotifier::open() {
+    if (socketPath_.size() >= sizeof(sockaddr_un::sun_path)) {
+        lastError_ = "Notification socket path too long: " + socketPath_;
+        return false;
+    }
+    fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        lastError_ = std::string("Failed to create notification socket: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void FrameNotifier::send(const FrameNotice& notice) {
+    if (fd_ < 0) return;
+
+    char message[4096];
+    int length = snprintf(message, sizeof(message),
+                          "kind=%s frame=%" PRIu64 " computer_time_ms=%" PRIu64 " hw_time_ns=%" PRIu64
+                          " hw_valid=%d commit_time_us=%" PRIu64 " bytes=%" PRIu64 " path=%s\n",
+                          notice.kind,
+                          notice.frameNumber,
+                          notice.computerTimeMs,
+                          notice.hardwareTimeNs,
+                          notice.hwTimeValid ? 1 : 0,
+                          systemTimeUs(),
+                          notice.bytes,
+                          notice.path.c_str());
+    if (length < 0 || length >= static_cast<int>(sizeof(message))) {
+        dropped_.fetch_add(1);
+        return;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, socketPath_.c_str(), socketPath_.size() + 1);
+
+    ssize_t ret = sendto(fd_, message, static_cast<size_t>(length), MSG_DONTWAIT | MSG_NOSIGNAL,
+                         reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    if (ret == length) {
+        sent_.fetch_add(1);
+    } else {
+        dropped_.fetch_add(1);  // No consumer bound (ENOENT/ECONNREFUSED) or queue full (EAGAIN)
+    }
+}
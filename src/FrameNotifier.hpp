@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// One committed output file, as announced to consumers
+struct FrameNotice {
+    const char* kind = "still";       // "still", "segment" or "recovered" (staged by an earlier run)
+    uint64_t frameNumber = 0;         // First frame of a segment
+    uint64_t computerTimeMs = 0;
+    uint64_t hardwareTimeNs = 0;
+    bool hwTimeValid = false;
+    uint64_t bytes = 0;
+    std::string path;                 // Final location of the file
+};
+
+// Announces committed files over a Unix datagram socket so consumers need not
+// scan or watch the output folder. The consumer binds the socket path; each
+// datagram is one text line:
+//
+//   kind=still frame=42 computer_time_ms=... hw_time_ns=... hw_valid=1
+//   commit_time_us=... bytes=183211 path=/data/out/2025..._18ms.jpg
+//
+// path is the last field and runs to the end of the line. Sends never block:
+// with no consumer bound, or its receive queue full, the notice is dropped
+// and counted.
+class FrameNotifier {
+public:
+    explicit FrameNotifier(const std::string& socketPath);
+    ~FrameNotifier();
+
+    FrameNotifier(const FrameNotifier&) = delete;
+    FrameNotifier& operator=(const FrameNotifier&) = delete;
+
+    bool open();
+    const std::string& lastError() const { return lastError_; }
+
+    // Safe to call from any thread
+    void send(const FrameNotice& notice);
+
+    uint64_t sent() const { return sent_.load(); }
+    uint64_t dropped() const { return dropped_.load(); }
+
+private:
+    std::string socketPath_;
+    int fd_ = -1;
+    std::string lastError_;
+    std::atomic<uint64_t> sent_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
@@ -0,0 +1,157 @@
+#include "ImageStats.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 32-bit SIMD lanes are flushed to 64-bit totals at least this often (pixels)
+constexpr int kChunkPixels = 1024;
+
+#if defined(__SSE2__)
+inline uint64_t horizontalSum32(__m128i v) {
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+inline int64_t horizontalSumSigned32(__m128i v) {
+    alignas(16) int32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+    return static_cast<int64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+// Sum and sum of squares of one row
+void accumulateRow(const uint8_t* row, int width, uint64_t& sum, uint64_t& sumSq) {
+    int x = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    while (x + 16 <= width) {
+        __m128i sumAcc = zero;
+        __m128i sqAcc = zero;
+        int end = std::min(width, x + kChunkPixels);
+        for (; x + 16 <= end; x += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+            sumAcc = _mm_add_epi64(sumAcc, _mm_sad_epu8(v, zero));
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            sqAcc = _mm_add_epi32(sqAcc, _mm_madd_epi16(lo, lo));
+            sqAcc = _mm_add_epi32(sqAcc, _mm_madd_epi16(hi, hi));
+        }
+        sum += static_cast<uint64_t>(_mm_cvtsi128_si32(sumAcc)) +
+               static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sumAcc, 8)));
+        sumSq += horizontalSum32(sqAcc);
+    }
+#endif
+    for (; x < width; ++x) {
+        uint32_t v = row[x];
+        sum += v;
+        sumSq += v * v;
+    }
+}
+
+// Sum and sum of squares of the 4-neighbour Laplacian over interior pixels of one row
+void accumulateLaplacianRow(const uint8_t* up, const uint8_t* row, const uint8_t* down,
+                            int width, int64_t& sum, uint64_t& sumSq) {
+    int x = 1;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    auto load8 = [&](const uint8_t* p) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), zero);
+    };
+    while (x + 8 <= width - 1) {
+        __m128i sumAcc = _mm_setzero_si128();
+        __m128i sqAcc = _mm_setzero_si128();
+        int end = std::min(width - 1, x + kChunkPixels);
+        for (; x + 8 <= end; x += 8) {
+            __m128i neighbours = _mm_add_epi16(
+                _mm_add_epi16(load8(row + x - 1), load8(row + x + 1)),
+                _mm_add_epi16(load8(up + x), load8(down + x)));
+            __m128i lap = _mm_sub_epi16(_mm_slli_epi16(load8(row + x), 2), neighbours);
+            sumAcc = _mm_add_epi32(sumAcc, _mm_madd_epi16(lap, ones));
+            sqAcc = _mm_add_epi32(sqAcc, _mm_madd_epi16(lap, lap));
+        }
+        sum += horizontalSumSigned32(sumAcc);
+        sumSq += horizontalSum32(sqAcc);
+    }
+#endif
+    for (; x < width - 1; ++x) {
+        int lap = 4 * row[x] - row[x - 1] - row[x + 1] - up[x] - down[x];
+        sum += lap;
+        sumSq += static_cast<uint64_t>(lap * lap);
+    }
+}
+
+// Four interleaved sub-histograms so consecutive equal pixels don't serialize on one counter
+void accumulateHistogram(const uint8_t* row, int width, uint32_t (&histograms)[4][256]) {
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        histograms[0][row[x]]++;
+        histograms[1][row[x + 1]]++;
+        histograms[2][row[x + 2]]++;
+        histograms[3][row[x + 3]]++;
+    }
+    for (; x < width; ++x) histograms[0][row[x]]++;
+}
+
+}  // namespace
+
+void computeImageStats(const uint8_t* luma, int stride, int width, int height, ImageStats& stats) {
+    stats = ImageStats{};
+    if (!luma || width < 3 || height < 3) return;
+
+    uint64_t sum = 0;
+    uint64_t sumSq = 0;
+    int64_t lapSum = 0;
+    uint64_t lapSumSq = 0;
+    uint32_t histograms[4][256] = {};
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = luma + static_cast<size_t>(y) * stride;
+        accumulateRow(row, width, sum, sumSq);
+        accumulateHistogram(row, width, histograms);
+        if (y > 0 && y < height - 1) {
+            accumulateLaplacianRow(row - stride, row, row + stride, width, lapSum, lapSumSq);
+        }
+    }
+
+    double pixels = static_cast<double>(width) * height;
+    double mean = sum / pixels;
+    stats.lumaMean = static_cast<float>(mean);
+    stats.lumaVariance = static_cast<float>(std::max(sumSq / pixels - mean * mean, 0.0));
+
+    double lapCount = static_cast<double>(width - 2) * (height - 2);
+    double lapMean = lapSum / lapCount;
+    stats.sharpness = static_cast<float>(std::max(lapSumSq / lapCount - lapMean * lapMean, 0.0));
+
+    constexpr int kLevelsPerBin = 256 / kHistogramBins;
+    for (int bin = 0; bin < kHistogramBins; ++bin) {
+        uint64_t count = 0;
+        for (int level = bin * kLevelsPerBin; level < (bin + 1) * kLevelsPerBin; ++level) {
+            count += histograms[0][level] + histograms[1][level] +
+                     histograms[2][level] + histograms[3][level];
+        }
+        stats.histogramPermille[bin] = static_cast<uint16_t>(count * 1000.0 / pixels + 0.5);
+    }
+    stats.valid = true;
+}
+
+ImageStats computeImageStats(const Frame& frame) {
+    ImageStats stats;
+    switch (frame.format) {
+        case FrameFormat::Yuv420:
+        case FrameFormat::Yuv422:
+        case FrameFormat::Gray8:
+            // The luma plane leads Frame::data and is tightly packed
+            computeImageStats(frame.data.data(), frame.width, frame.width, frame.height, stats);
+            break;
+        default:
+            break;
+    }
+    return stats;
+}
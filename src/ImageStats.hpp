@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Frame.hpp"
+
+#include <cstdint>
+
+constexpr int kHistogramBins = 16;
+
+// Per-frame luma statistics for capture-time QA
+struct ImageStats {
+    bool valid = false;
+    float lumaMean = 0.0f;
+    float lumaVariance = 0.0f;
+    float sharpness = 0.0f;                          // Variance of the 4-neighbour Laplacian
+    uint16_t histogramPermille[kHistogramBins] = {}; // Luma histogram, 16 levels per bin
+};
+
+// Compute statistics over an 8-bit luma plane (SSE2 where available)
+void computeImageStats(const uint8_t* luma, int stride, int width, int height, ImageStats& stats);
+
+// Statistics for a raw frame's luma plane; invalid for Rgb24 and Jpeg frames
+ImageStats computeImageStats(const Frame& frame);
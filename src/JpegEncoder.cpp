@@ -0,0 +1,207 @@
+#include "JpegEncoder.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+// libjpeg destination manager that writes into a growable std::vector
+namespace {
+
+struct VectorDestination {
+    struct jpeg_destination_mgr pub;
+    std::vector<uint8_t>* buffer;
+};
+
+void initVectorDestination(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+    // Start from the previous capacity; a quarter of the raw size covers most frames
+    size_t initial = std::max<size_t>(dest->buffer->capacity(),
+                                      static_cast<size_t>(cinfo->image_width) *
+                                      cinfo->image_height * cinfo->input_components / 4);
+    dest->buffer->resize(std::max<size_t>(initial, 4096));
+    dest->pub.next_output_byte = dest->buffer->data();
+    dest->pub.free_in_buffer = dest->buffer->size();
+}
+
+boolean emptyVectorDestination(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+    size_t used = dest->buffer->size();
+    dest->buffer->resize(used * 2);
+    dest->pub.next_output_byte = dest->buffer->data() + used;
+    dest->pub.free_in_buffer = dest->buffer->size() - used;
+    return TRUE;
+}
+
+void termVectorDestination(j_compress_ptr cinfo) {
+    auto* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+    dest->buffer->resize(dest->buffer->size() - dest->pub.free_in_buffer);
+}
+
+void setVectorDestination(j_compress_ptr cinfo, VectorDestination& dest,
+                          std::vector<uint8_t>& jpeg) {
+    dest.pub.init_destination = initVectorDestination;
+    dest.pub.empty_output_buffer = emptyVectorDestination;
+    dest.pub.term_destination = termVectorDestination;
+    dest.buffer = &jpeg;
+    cinfo->dest = &dest.pub;
+}
+
+// libjpeg prints warnings to stderr from the encoding thread; hand them to
+// the async logger instead
+void logJpegMessage(j_common_ptr cinfo) {
+    char message[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, message);
+    Log::warning("libjpeg: {}", message);
+}
+
+struct jpeg_error_mgr* loggingErrorManager(struct jpeg_error_mgr* err) {
+    jpeg_std_error(err);
+    err->output_message = logJpegMessage;
+    return err;
+}
+
+}  // namespace
+
+bool encodeFrameToJPEG(const Frame& frame, int quality, std::vector<uint8_t>& jpeg) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = loggingErrorManager(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    VectorDestination dest;
+    setVectorDestination(&cinfo, dest, jpeg);
+
+    cinfo.image_width = frame.width;
+    cinfo.image_height = frame.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    JSAMPROW row_pointer[1];
+    const uint8_t* imageData = frame.data.data();
+    int rowStride = frame.width * 3;
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        row_pointer[0] = (JSAMPROW)(imageData + cinfo.next_scanline * rowStride);
+        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return !jpeg.empty();
+}
+
+bool encodeGrayJPEG(const Frame& frame, int quality, std::vector<uint8_t>& jpeg) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = loggingErrorManager(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    VectorDestination dest;
+    setVectorDestination(&cinfo, dest, jpeg);
+
+    cinfo.image_width = frame.width;
+    cinfo.image_height = frame.height;
+    cinfo.input_components = 1;
+    cinfo.in_color_space = JCS_GRAYSCALE;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    JSAMPROW rows[DCTSIZE];
+    const uint8_t* imageData = frame.data.data();
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JDIMENSION count = std::min<JDIMENSION>(DCTSIZE, cinfo.image_height - cinfo.next_scanline);
+        for (JDIMENSION i = 0; i < count; ++i) {
+            rows[i] = const_cast<JSAMPROW>(
+                imageData + static_cast<size_t>(cinfo.next_scanline + i) * frame.width);
+        }
+        jpeg_write_scanlines(&cinfo, rows, count);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return !jpeg.empty();
+}
+
+template <int ChromaRowShift, int FixedWidth, int FixedHeight>
+bool encodePlanarJPEG(const Frame& frame, int quality, std::vector<uint8_t>& jpeg) {
+    constexpr int kLumaRows = DCTSIZE << ChromaRowShift;   // Rows per jpeg_write_raw_data call
+    constexpr int kChromaRows = DCTSIZE;
+
+    const int width = FixedWidth ? FixedWidth : frame.width;
+    const int height = FixedHeight ? FixedHeight : frame.height;
+    const int chromaWidth = width / 2;
+    const int chromaHeight = (height + ChromaRowShift) >> ChromaRowShift;
+
+    const uint8_t* yPlane = frame.data.data();
+    const uint8_t* cbPlane = yPlane + static_cast<size_t>(width) * height;
+    const uint8_t* crPlane = cbPlane + static_cast<size_t>(chromaWidth) * chromaHeight;
+
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = loggingErrorManager(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    VectorDestination dest;
+    setVectorDestination(&cinfo, dest, jpeg);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 1 << ChromaRowShift;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    JSAMPROW yRows[kLumaRows];
+    JSAMPROW cbRows[kChromaRows];
+    JSAMPROW crRows[kChromaRows];
+    JSAMPARRAY planes[3] = {yRows, cbRows, crRows};
+
+    // Rows past the bottom edge repeat the last row (libjpeg pads the final MCU row)
+    for (int row = 0; row < height; row += kLumaRows) {
+        for (int i = 0; i < kLumaRows; ++i) {
+            int y = std::min(row + i, height - 1);
+            yRows[i] = const_cast<JSAMPROW>(yPlane + static_cast<size_t>(y) * width);
+        }
+        int chromaRow = row >> ChromaRowShift;
+        for (int i = 0; i < kChromaRows; ++i) {
+            int y = std::min(chromaRow + i, chromaHeight - 1);
+            cbRows[i] = const_cast<JSAMPROW>(cbPlane + static_cast<size_t>(y) * chromaWidth);
+            crRows[i] = const_cast<JSAMPROW>(crPlane + static_cast<size_t>(y) * chromaWidth);
+        }
+        jpeg_write_raw_data(&cinfo, planes, kLumaRows);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return !jpeg.empty();
+}
+
+// Runtime-dimension versions plus exactly the modes in the kernel table
+// (FrameKernels.cpp): 1080p is 4:2:0, 720p is 4:2:2
+template bool encodePlanarJPEG<1>(const Frame&, int, std::vector<uint8_t>&);
+template bool encodePlanarJPEG<0>(const Frame&, int, std::vector<uint8_t>&);
+template bool encodePlanarJPEG<1, 1920, 1080>(const Frame&, int, std::vector<uint8_t>&);
+template bool encodePlanarJPEG<0, 1280, 720>(const Frame&, int, std::vector<uint8_t>&);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Frame.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Encode an RGB24 frame to JPEG in memory. `jpeg` is resized to the encoded
+// size; reuse it across calls to avoid reallocating per frame.
+bool encodeFrameToJPEG(const Frame& frame, int quality, std::vector<uint8_t>& jpeg);
+
+// Encode a planar full-range YCbCr frame (Yuv420 / Yuv422) through libjpeg's
+// raw-data interface, skipping color conversion and downsampling.
+// ChromaRowShift is 1 for 4:2:0 and 0 for 4:2:2. FixedWidth/FixedHeight of 0
+// take dimensions from the frame; nonzero values compile in the known modes.
+// Width must be a multiple of 16 (one 4:2:x MCU).
+template <int ChromaRowShift, int FixedWidth = 0, int FixedHeight = 0>
+bool encodePlanarJPEG(const Frame& frame, int quality, std::vector<uint8_t>& jpeg);
+
+// Encode a Gray8 frame as a single-component JPEG. libjpeg reads the rows in
+// place; there is no color conversion and a third of the entropy coding.
+bool encodeGrayJPEG(const Frame& frame, int quality, std::vector<uint8_t>& jpeg);
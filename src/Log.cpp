@@ -0,0 +1,270 @@
+#include "Log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Log {
+namespace detail {
+namespace {
+
+constexpr size_t kRingSize = 256;           // Records per thread; power of two
+constexpr int kFormatIntervalMs = 20;
+
+// Single-producer ring owned by one logging thread and drained by the
+// formatter: the owner only moves head, the formatter only moves tail
+struct ThreadRing {
+    Record records[kRingSize];
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<bool> retired{false};       // Owning thread has exited
+    uint32_t id = 0;
+};
+
+class Logger {
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            stop_ = true;
+        }
+        wakeCv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        drain();
+    }
+
+    std::shared_ptr<ThreadRing> registerThread() {
+        auto ring = std::make_shared<ThreadRing>();
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        ring->id = ++nextId_;
+        rings_.push_back(ring);
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&Logger::formatterThreadFunc, this);
+        }
+        return ring;
+    }
+
+    void drain();
+
+    std::atomic<uint64_t> dropped{0};
+
+private:
+    Logger() = default;
+
+    struct Pending {
+        ThreadRing* ring;
+        const Record* record;
+    };
+
+    void formatterThreadFunc();
+    void format(const ThreadRing& ring, const Record& record);
+
+    std::mutex ringsMutex_;
+    std::vector<std::shared_ptr<ThreadRing>> rings_;
+    uint32_t nextId_ = 0;
+
+    std::mutex drainMutex_;                 // One drain at a time (thread or flush())
+    std::vector<Pending> pending_;
+    std::string line_;
+    uint64_t reportedDropped_ = 0;
+
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+// Keeps this thread's ring registered; the ring outlives the thread until
+// the formatter has written everything in it
+struct RingHolder {
+    std::shared_ptr<ThreadRing> ring;
+
+    ~RingHolder() {
+        if (ring) ring->retired.store(true, std::memory_order_release);
+    }
+};
+
+thread_local RingHolder threadRing;
+
+ThreadRing& currentRing() {
+    if (!threadRing.ring) {
+        threadRing.ring = Logger::instance().registerThread();
+    }
+    return *threadRing.ring;
+}
+
+void appendArg(std::string& out, const Record& record, size_t index, size_t& offset) {
+    char number[32];
+    int length = 0;
+    switch (record.argTypes[index]) {
+        case ArgType::Int: {
+            int64_t value;
+            std::memcpy(&value, record.payload + offset, sizeof(value));
+            offset += sizeof(value);
+            length = snprintf(number, sizeof(number), "%lld", static_cast<long long>(value));
+            break;
+        }
+        case ArgType::Uint: {
+            uint64_t value;
+            std::memcpy(&value, record.payload + offset, sizeof(value));
+            offset += sizeof(value);
+            length = snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(value));
+            break;
+        }
+        case ArgType::Double: {
+            double value;
+            std::memcpy(&value, record.payload + offset, sizeof(value));
+            offset += sizeof(value);
+            length = snprintf(number, sizeof(number), "%g", value);
+            break;
+        }
+        case ArgType::String: {
+            size_t size = record.payload[offset];
+            out.append(reinterpret_cast<const char*>(record.payload + offset + 1), size);
+            offset += size + 1;
+            return;
+        }
+    }
+    out.append(number, static_cast<size_t>(std::max(length, 0)));
+}
+
+void Logger::format(const ThreadRing& ring, const Record& record) {
+    // "12:34:56.789012 WARN  [writer 3] message"
+    time_t seconds = static_cast<time_t>(record.timeNs / 1000000000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char prefix[64];
+    static const char* const kLevels[] = {"INFO ", "WARN ", "ERROR"};
+    const char* name = ring.name.load(std::memory_order_relaxed);
+    int length = snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%06u %s [%s %u] ",
+                          local.tm_hour, local.tm_min, local.tm_sec,
+                          static_cast<unsigned>(record.timeNs % 1000000000 / 1000),
+                          kLevels[static_cast<int>(record.level)],
+                          name ? name : "thread", ring.id);
+    line_.assign(prefix, static_cast<size_t>(std::max(length, 0)));
+
+    size_t arg = 0;
+    size_t offset = 0;
+    for (const char* p = record.format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}' && arg < record.argCount) {
+            appendArg(line_, record, arg++, offset);
+            ++p;
+        } else {
+            line_.push_back(*p);
+        }
+    }
+    line_.push_back('\n');
+
+    FILE* stream = record.level == Level::Info ? stdout : stderr;
+    fwrite(line_.data(), 1, line_.size(), stream);
+}
+
+void Logger::drain() {
+    std::lock_guard<std::mutex> drainLock(drainMutex_);
+
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings = rings_;
+    }
+
+    // Merge every thread's records into one time-ordered batch
+    std::vector<uint64_t> heads(rings.size());
+    std::vector<bool> retired(rings.size());
+    pending_.clear();
+    for (size_t i = 0; i < rings.size(); ++i) {
+        ThreadRing& ring = *rings[i];
+        retired[i] = ring.retired.load(std::memory_order_acquire);
+        heads[i] = ring.head.load(std::memory_order_acquire);
+        for (uint64_t pos = ring.tail.load(std::memory_order_relaxed); pos != heads[i]; ++pos) {
+            pending_.push_back({&ring, &ring.records[pos & (kRingSize - 1)]});
+        }
+    }
+    std::stable_sort(pending_.begin(), pending_.end(), [](const Pending& a, const Pending& b) {
+        return a.record->timeNs < b.record->timeNs;
+    });
+
+    for (const Pending& entry : pending_) {
+        format(*entry.ring, *entry.record);
+    }
+
+    uint64_t dropped = this->dropped.load();
+    if (dropped > reportedDropped_) {
+        fprintf(stderr, "Log: %llu records dropped (log buffers full)\n",
+                static_cast<unsigned long long>(dropped - reportedDropped_));
+        reportedDropped_ = dropped;
+    }
+    if (!pending_.empty()) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+
+    // Slots are handed back only after formatting read them in place
+    for (size_t i = 0; i < rings.size(); ++i) {
+        rings[i]->tail.store(heads[i], std::memory_order_release);
+    }
+
+    // A ring whose thread exited and whose records are all written goes away
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    for (size_t i = 0; i < rings.size(); ++i) {
+        if (!retired[i]) continue;
+        rings_.erase(std::remove(rings_.begin(), rings_.end(), rings[i]), rings_.end());
+    }
+}
+
+void Logger::formatterThreadFunc() {
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    while (!stop_) {
+        wakeCv_.wait_for(lock, std::chrono::milliseconds(kFormatIntervalMs));
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+}  // namespace
+
+Record* beginRecord() {
+    ThreadRing& ring = currentRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= kRingSize) {
+        Logger::instance().dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &ring.records[head & (kRingSize - 1)];
+}
+
+void commitRecord() {
+    ThreadRing& ring = *threadRing.ring;
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+}  // namespace detail
+
+void setThreadName(const char* name) {
+    detail::currentRing().name.store(name, std::memory_order_relaxed);
+}
+
+void flush() {
+    detail::Logger::instance().drain();
+}
+
+uint64_t droppedRecords() {
+    return detail::Logger::instance().dropped.load();
+}
+
+}  // namespace Log
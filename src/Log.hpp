@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logger for driver code. A log call copies the format string
+// pointer and its raw arguments into the calling thread's own ring buffer:
+// no lock, no formatting, no system call. A background thread formats the
+// records in time order and writes them to stdout (info) or stderr (warnings
+// and errors). When a thread's ring is full the record is dropped and
+// counted, so a logging storm during a disk failure never slows capture.
+//
+// Format strings must be string literals; each "{}" is replaced by the next
+// argument (integers, floating point, strings). Strings are copied and may
+// be truncated.
+namespace Log {
+
+enum class Level : uint8_t {
+    Info,
+    Warning,
+    Error
+};
+
+namespace detail {
+
+enum class ArgType : uint8_t {
+    Int,
+    Uint,
+    Double,
+    String
+};
+
+constexpr size_t kMaxArgs = 8;
+constexpr size_t kPayloadBytes = 200;
+
+struct Record {
+    uint64_t timeNs;                // System clock
+    const char* format;
+    Level level;
+    uint8_t argCount;
+    uint8_t payloadSize;
+    ArgType argTypes[kMaxArgs];
+    uint8_t payload[kPayloadBytes]; // Arguments, packed in order
+};
+
+// Free slot in this thread's ring, or null (and counted) when it is full
+Record* beginRecord();
+// Publish the slot returned by beginRecord()
+void commitRecord();
+
+inline void encodeBytes(Record& record, ArgType type, const void* data, size_t size) {
+    if (record.argCount >= kMaxArgs || record.payloadSize + size > kPayloadBytes) return;
+    std::memcpy(record.payload + record.payloadSize, data, size);
+    record.payloadSize += static_cast<uint8_t>(size);
+    record.argTypes[record.argCount++] = type;
+}
+
+inline void encodeString(Record& record, std::string_view text) {
+    if (record.argCount >= kMaxArgs || record.payloadSize >= kPayloadBytes) return;
+    size_t length = std::min(text.size(), kPayloadBytes - record.payloadSize - 1);
+    record.payload[record.payloadSize] = static_cast<uint8_t>(length);
+    std::memcpy(record.payload + record.payloadSize + 1, text.data(), length);
+    record.payloadSize += static_cast<uint8_t>(length + 1);
+    record.argTypes[record.argCount++] = ArgType::String;
+}
+
+template <typename T>
+void encodeArg(Record& record, const T& value) {
+    if constexpr (std::is_enum_v<T>) {
+        encodeArg(record, static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        int64_t v = value;
+        encodeBytes(record, ArgType::Int, &v, sizeof(v));
+    } else if constexpr (std::is_integral_v<T>) {
+        uint64_t v = value;
+        encodeBytes(record, ArgType::Uint, &v, sizeof(v));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        double v = value;
+        encodeBytes(record, ArgType::Double, &v, sizeof(v));
+    } else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>) {
+        encodeString(record, value ? std::string_view(value) : std::string_view("(null)"));
+    } else {
+        static_assert(std::is_convertible_v<const T&, std::string_view>,
+                      "Log arguments must be numbers or strings");
+        encodeString(record, std::string_view(value));
+    }
+}
+
+}  // namespace detail
+
+template <typename... Args>
+void write(Level level, const char* format, const Args&... args) {
+    detail::Record* record = detail::beginRecord();
+    if (!record) return;
+
+    record->timeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    record->format = format;
+    record->level = level;
+    record->argCount = 0;
+    record->payloadSize = 0;
+    (detail::encodeArg(*record, args), ...);
+    detail::commitRecord();
+}
+
+template <typename... Args>
+void info(const char* format, const Args&... args) {
+    write(Level::Info, format, args...);
+}
+
+template <typename... Args>
+void warning(const char* format, const Args&... args) {
+    write(Level::Warning, format, args...);
+}
+
+template <typename... Args>
+void error(const char* format, const Args&... args) {
+    write(Level::Error, format, args...);
+}
+
+// Label for the calling thread's records; `name` must be a string literal
+void setThreadName(const char* name);
+
+// Format and write everything logged so far before returning
+void flush();
+
+// Records lost to full rings since startup
+uint64_t droppedRecords();
+
+}  // namespace Log
@@ -0,0 +1,210 @@
+#include "MjpegRemuxWriter.hpp"
+#include "FrameIndex.hpp"
+#include "OutputStriping.hpp"
+#include "FrameNotifier.hpp"
+
+#include <cstring>
+#include <sstream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+}
+
+// Container timebase: milliseconds of computer receive time
+static const AVRational kContainerTimebase = {1, 1000};
+
+MjpegRemuxWriter::MjpegRemuxWriter(const std::string& outputFolder,
+                                   const PassthroughOptions& options,
+                                   FrameIndex* index,
+                                   OutputStriping* striping,
+                                   FrameNotifier* notifier)
+    : outputFolder_(outputFolder),
+      options_(options),
+      index_(index),
+      striping_(striping),
+      notifier_(notifier) {
+}
+
+MjpegRemuxWriter::~MjpegRemuxWriter() {
+    close();
+}
+
+bool MjpegRemuxWriter::fail(const std::string& message, const std::string& detail) {
+    lastError_ = message;
+    lastErrorDetail_ = detail;
+    closeSegment();
+    return false;
+}
+
+bool MjpegRemuxWriter::openSegment(const Frame& frame) {
+    std::ostringstream oss;
+    oss << formatComputerTime(frame.computerTimeMs)
+        << "_" << (frame.hwTimeValid ? "HW_" : "ERR_") << frame.hardwareTimeNs
+        << "." << options_.container;
+    segmentName_ = oss.str();
+
+    std::string folder = outputFolder_;
+    if (striping_) {
+        segmentRoot_ = striping_->acquire(0);
+        if (segmentRoot_ < 0) {
+            return fail("No output root has free space for a new segment", segmentName_);
+        }
+        segmentRootPath_ = striping_->root(segmentRoot_);
+        folder = segmentRootPath_;
+    }
+    segmentStartBytes_ = bytesWritten_;
+    segmentFirstFrame_ = frame.frameNumber;
+    segmentFirstHwNs_ = frame.hardwareTimeNs;
+    segmentFirstHwValid_ = frame.hwTimeValid;
+    segmentPath_ = folder + "/" + segmentName_;
+    const std::string& path = segmentPath_;
+
+    AVFormatContext* formatCtx = nullptr;
+    if (avformat_alloc_output_context2(&formatCtx, nullptr, nullptr, path.c_str()) < 0 ||
+        !formatCtx) {
+        return fail("Failed to create muxer", path);
+    }
+    formatCtx_.reset(formatCtx);
+
+    stream_ = avformat_new_stream(formatCtx_.get(), nullptr);
+    if (!stream_) {
+        return fail("Failed to create output stream");
+    }
+    stream_->time_base = kContainerTimebase;
+    stream_->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    stream_->codecpar->codec_id = AV_CODEC_ID_MJPEG;
+    stream_->codecpar->codec_tag = 0;  // Let the muxer pick (MJPG for AVI, V_MJPEG for MKV)
+    stream_->codecpar->width = frame.width;
+    stream_->codecpar->height = frame.height;
+
+    if (!(formatCtx_->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&formatCtx_->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) {
+            return fail("Failed to open segment file", path);
+        }
+    }
+
+    if (avformat_write_header(formatCtx_.get(), nullptr) < 0) {
+        return fail("Failed to write segment header", path);
+    }
+    headerWritten_ = true;
+
+    packet_.reset(av_packet_alloc());
+    if (!packet_) {
+        return fail("Failed to allocate packet");
+    }
+
+    segmentWidth_ = frame.width;
+    segmentHeight_ = frame.height;
+    segmentStartMs_ = frame.computerTimeMs;
+    lastPts_ = -1;
+    segmentFrames_ = 0;
+    return true;
+}
+
+bool MjpegRemuxWriter::write(const Frame& frame, FrameTiming& timing) {
+    uint64_t writeStartUs = steadyTimeUs();
+
+    // Roll over on duration or resolution change
+    if (formatCtx_) {
+        bool expired = frame.computerTimeMs - segmentStartMs_ >=
+                       static_cast<uint64_t>(options_.segmentSeconds) * 1000;
+        bool resized = frame.width != segmentWidth_ || frame.height != segmentHeight_;
+        if (expired || resized) {
+            closeSegment();
+        }
+    }
+
+    if (!formatCtx_ && !openSegment(frame)) {
+        return false;
+    }
+
+    if (av_new_packet(packet_.get(), static_cast<int>(frame.data.size())) < 0) {
+        return fail("Failed to allocate packet data");
+    }
+    memcpy(packet_->data, frame.data.data(), frame.data.size());
+
+    // Millisecond PTS relative to segment start; must be strictly increasing
+    int64_t pts = static_cast<int64_t>(frame.computerTimeMs - segmentStartMs_);
+    if (pts <= lastPts_) {
+        pts = lastPts_ + 1;
+    }
+    lastPts_ = pts;
+
+    packet_->pts = pts;
+    packet_->dts = pts;
+    packet_->flags |= AV_PKT_FLAG_KEY;
+    packet_->stream_index = stream_->index;
+    av_packet_rescale_ts(packet_.get(), kContainerTimebase, stream_->time_base);
+    int64_t containerPts = packet_->pts;
+
+    int64_t offset = formatCtx_->pb ? avio_tell(formatCtx_->pb) : -1;
+    int ret = av_write_frame(formatCtx_.get(), packet_.get());
+    av_packet_unref(packet_.get());
+    if (ret < 0) {
+        return fail("Failed to write MJPEG packet", segmentName_);
+    }
+    bytesWritten_ += frame.data.size();
+    int64_t segmentFrame = segmentFrames_++;
+    timing.writeUs = steadyTimeUs() - writeStartUs;
+
+    if (index_) {
+        index_->append({
+            frame.frameNumber,
+            frame.computerTimeMs,
+            frame.hardwareTimeNs,
+            frame.hwTimeValid,
+            timing.latencyUs() / 1000,
+            timing,
+            frame.packetTimeUs,
+            frame.computerTimeUs,
+            systemTimeUs(),
+            frame.data.size(),
+            segmentName_,
+            containerPts,
+            offset,
+            segmentFrame,
+            frame.sei,
+            ImageStats{},  // Packets are not decoded
+            segmentRootPath_
+        });
+    }
+    return true;
+}
+
+void MjpegRemuxWriter::closeSegment() {
+    if (headerWritten_) {
+        av_write_trailer(formatCtx_.get());
+        segmentsWritten_++;
+    }
+    bool finished = headerWritten_;
+    headerWritten_ = false;
+
+    formatCtx_.reset();
+    stream_ = nullptr;
+    packet_.reset();
+
+    // Announce only after the file is closed and complete
+    if (finished && notifier_) {
+        FrameNotice notice;
+        notice.kind = "segment";
+        notice.frameNumber = segmentFirstFrame_;
+        notice.computerTimeMs = segmentStartMs_;
+        notice.hardwareTimeNs = segmentFirstHwNs_;
+        notice.hwTimeValid = segmentFirstHwValid_;
+        notice.bytes = bytesWritten_ - segmentStartBytes_;
+        notice.path = segmentPath_;
+        notifier_->send(notice);
+    }
+
+    if (segmentRoot_ >= 0) {
+        striping_->release(segmentRoot_, 0, bytesWritten_ - segmentStartBytes_, 0);
+        segmentRoot_ = -1;
+    }
+}
+
+void MjpegRemuxWriter::close() {
+    closeSegment();
+    if (index_) index_->flush();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+#include "Frame.hpp"
+#include "FFmpegHandles.hpp"
+
+#include <string>
+
+class FrameIndex;
+class OutputStriping;
+class FrameNotifier;
+
+// Writes MJPEG packets unchanged into rolling MKV/AVI segments,
+// recording each frame's container timestamp and byte offset in the index.
+// With striping, each segment goes to the least loaded output root.
+class MjpegRemuxWriter {
+public:
+    MjpegRemuxWriter(const std::string& outputFolder,
+                     const PassthroughOptions& options,
+                     FrameIndex* index,
+                     OutputStriping* striping = nullptr,
+                     FrameNotifier* notifier = nullptr);
+    ~MjpegRemuxWriter();
+
+    MjpegRemuxWriter(const MjpegRemuxWriter&) = delete;
+    MjpegRemuxWriter& operator=(const MjpegRemuxWriter&) = delete;
+
+    // Mux one JPEG frame, rolling over to a new segment when due.
+    // `timing` carries the queue wait in and receives the mux time.
+    // Returns false on failure; see lastError().
+    bool write(const Frame& frame, FrameTiming& timing);
+
+    // Finalize the current segment (writes the seek index / cues)
+    void close();
+
+    const std::string& lastError() const { return lastError_; }
+    const std::string& lastErrorDetail() const { return lastErrorDetail_; }   // Path, if any
+    uint64_t segmentsWritten() const { return segmentsWritten_; }
+    uint64_t bytesWritten() const { return bytesWritten_; }
+
+private:
+    bool openSegment(const Frame& frame);
+    void closeSegment();
+    bool fail(const std::string& message, const std::string& detail = "");
+
+    std::string outputFolder_;
+    PassthroughOptions options_;
+    FrameIndex* index_;
+    OutputStriping* striping_;
+    FrameNotifier* notifier_;
+
+    OutputFormatPtr formatCtx_;
+    AVStream* stream_ = nullptr;        // Owned by formatCtx_
+    AVPacketPtr packet_;
+    bool headerWritten_ = false;
+
+    std::string segmentName_;
+    std::string segmentPath_;
+    int segmentRoot_ = -1;
+    std::string segmentRootPath_;       // Empty unless striping
+    uint64_t segmentStartBytes_ = 0;
+    uint64_t segmentFirstFrame_ = 0;     // First frame, announced with the finished segment
+    uint64_t segmentFirstHwNs_ = 0;
+    bool segmentFirstHwValid_ = false;
+    int segmentWidth_ = 0;
+    int segmentHeight_ = 0;
+    uint64_t segmentStartMs_ = 0;
+    int64_t lastPts_ = -1;
+    int64_t segmentFrames_ = 0;         // Frames muxed into the current segment
+    uint64_t segmentsWritten_ = 0;
+    uint64_t bytesWritten_ = 0;
+    std::string lastError_;
+    std::string lastErrorDetail_;
+};
@@ -0,0 +1,139 @@
+#include "OutputStriping.hpp"
+#include "Frame.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <mutex>
+
+#include <sys/statvfs.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint64_t kFreeSpaceRefreshUs = 1000000;
+constexpr double kSpeedSmoothing = 0.1;           // EWMA weight of the newest write
+
+}  // namespace
+
+struct OutputStriping::RootState {
+    std::string path;
+    std::mutex mutex;
+    int inflight = 0;
+    double usPerMB = 1000.0;          // Smoothed write time per MB; 1 GB/s until measured
+    uint64_t freeBytes = 0;           // statvfs result minus bytes handed out since
+    uint64_t lastStatUs = 0;
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+
+    void refreshFreeSpace(uint64_t nowUs) {
+        struct statvfs vfs;
+        if (statvfs(path.c_str(), &vfs) == 0) {
+            freeBytes = static_cast<uint64_t>(vfs.f_bavail) * vfs.f_frsize;
+        }
+        lastStatUs = nowUs;
+    }
+};
+
+namespace {
+
+// One state per root path, so captures striping over the same disks see
+// each other's load
+std::shared_ptr<OutputStriping::RootState> sharedRootState(const std::string& path) {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::weak_ptr<OutputStriping::RootState>> registry;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& slot = registry[path];
+    auto state = slot.lock();
+    if (!state) {
+        state = std::make_shared<OutputStriping::RootState>();
+        state->path = path;
+        slot = state;
+    }
+    return state;
+}
+
+}  // namespace
+
+OutputStriping::OutputStriping(const std::vector<std::string>& roots, uint64_t minFreeBytes)
+    : minFreeBytes_(minFreeBytes) {
+    for (const auto& path : roots) {
+        std::error_code ec;
+        fs::create_directories(path, ec);
+        if (ec) {
+            Log::error("Failed to create output root {}: {}", path, ec.message());
+        }
+        roots_.push_back(sharedRootState(path));
+    }
+}
+
+int OutputStriping::acquire(uint64_t bytes) {
+    uint64_t nowUs = steadyTimeUs();
+    int best = -1;
+    double bestLoad = 0.0;
+    uint64_t bestFree = 0;
+    size_t start = nextRoot_.load();
+
+    for (size_t n = 0; n < roots_.size(); ++n) {
+        size_t i = (start + n) % roots_.size();
+        RootState& state = *roots_[i];
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        if (state.lastStatUs == 0 || nowUs - state.lastStatUs >= kFreeSpaceRefreshUs) {
+            state.refreshFreeSpace(nowUs);
+        }
+        if (state.freeBytes < minFreeBytes_ + bytes) continue;
+
+        // Queued work on this disk, in expected microseconds per MB
+        double load = (state.inflight + 1) * state.usPerMB;
+        if (best < 0 || load < bestLoad || (load == bestLoad && state.freeBytes > bestFree)) {
+            best = static_cast<int>(i);
+            bestLoad = load;
+            bestFree = state.freeBytes;
+        }
+    }
+
+    if (best >= 0) {
+        RootState& state = *roots_[best];
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.inflight++;
+        state.freeBytes -= std::min(bytes, state.freeBytes);
+        nextRoot_.store((best + 1) % roots_.size());
+    }
+    return best;
+}
+
+void OutputStriping::release(int root, uint64_t reservedBytes, uint64_t bytes,
+                             uint64_t writeUs) {
+    RootState& state = *roots_[root];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.inflight--;
+    // Until the next statvfs, free space is the estimate minus what was written
+    state.freeBytes += reservedBytes;
+    state.freeBytes -= std::min(bytes, state.freeBytes);
+    if (bytes > 0) state.files++;  // 0 for a failed write
+    state.bytes += bytes;
+    if (writeUs > 0 && bytes > 0) {
+        double usPerMB = writeUs * 1048576.0 / bytes;
+        state.usPerMB += kSpeedSmoothing * (usPerMB - state.usPerMB);
+    }
+}
+
+const std::string& OutputStriping::root(int index) const {
+    return roots_[index]->path;
+}
+
+OutputRootStats OutputStriping::stats(int index) const {
+    RootState& state = *roots_[index];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return {
+        state.path,
+        state.files,
+        state.bytes,
+        state.freeBytes,
+        state.usPerMB > 0.0 ? static_cast<float>(1e6 / state.usPerMB) : 0.0f
+    };
+}
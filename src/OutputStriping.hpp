@@ -0,0 +1,39 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Spreads output files over several root folders (one per disk). Each file
+// goes to the root with the least load (writes in flight weighted by recent
+// write speed) among those with free space to spare. Load state is shared by
+// every capture in the process that writes to the same root.
+class OutputStriping {
+public:
+    OutputStriping(const std::vector<std::string>& roots, uint64_t minFreeBytes);
+
+    // Pick a root for a file of about `bytes`; -1 when every root is full
+    int acquire(uint64_t bytes);
+
+    // The file on `root` is finished (bytes of 0: it was not written).
+    // `reservedBytes` is what acquire() was given; the difference to `bytes`
+    // goes back to the root's free space. writeUs of 0 leaves the speed
+    // estimate alone (e.g. long-lived segment files)
+    void release(int root, uint64_t reservedBytes, uint64_t bytes, uint64_t writeUs);
+
+    const std::string& root(int index) const;
+    size_t size() const { return roots_.size(); }
+
+    OutputRootStats stats(int index) const;
+
+    struct RootState;
+
+private:
+    std::vector<std::shared_ptr<RootState>> roots_;
+    uint64_t minFreeBytes_;
+    std::atomic<size_t> nextRoot_{0};   // Round-robin start among equally loaded roots
+};
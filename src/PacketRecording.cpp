@@ -0,0 +1,148 @@
+#include "PacketRecording.hpp"
+
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+const char kMagic[8] = {'C', 'A', 'M', 'R', 'E', 'C', '0', '1'};
+
+constexpr uint64_t kFlushIntervalUs = 1000000;
+
+uint64_t steadyNowUs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+template <typename T>
+bool writeValue(FILE* file, T value) {
+    return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+template <typename T>
+bool readValue(FILE* file, T& value) {
+    return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+}  // namespace
+
+PacketRecorder::~PacketRecorder() {
+    close();
+}
+
+bool PacketRecorder::open(const std::string& path, const AVCodecParameters* codecpar,
+                          AVRational timebase) {
+    close();
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) return false;
+
+    uint32_t extradataSize = codecpar->extradata ? static_cast<uint32_t>(codecpar->extradata_size) : 0;
+    bool ok = fwrite(kMagic, sizeof(kMagic), 1, file_) == 1 &&
+              writeValue<int32_t>(file_, codecpar->codec_id) &&
+              writeValue<int32_t>(file_, codecpar->width) &&
+              writeValue<int32_t>(file_, codecpar->height) &&
+              writeValue<int32_t>(file_, codecpar->format) &&
+              writeValue<int32_t>(file_, codecpar->color_range) &&
+              writeValue<int32_t>(file_, timebase.num) &&
+              writeValue<int32_t>(file_, timebase.den) &&
+              writeValue<uint32_t>(file_, extradataSize) &&
+              (extradataSize == 0 || fwrite(codecpar->extradata, extradataSize, 1, file_) == 1);
+    if (!ok || fflush(file_) != 0) {
+        close();
+        return false;
+    }
+    lastFlushUs_ = steadyNowUs();
+    return true;
+}
+
+bool PacketRecorder::write(const AVPacket* packet, uint64_t arrivalUs) {
+    if (!file_) return false;
+
+    bool ok = writeValue<uint64_t>(file_, arrivalUs) &&
+              writeValue<int64_t>(file_, packet->pts) &&
+              writeValue<int64_t>(file_, packet->dts) &&
+              writeValue<int32_t>(file_, packet->flags) &&
+              writeValue<uint32_t>(file_, static_cast<uint32_t>(packet->size)) &&
+              (packet->size == 0 || fwrite(packet->data, packet->size, 1, file_) == 1);
+    if (!ok) return false;
+    packets_++;
+
+    // A keyframe starts what a replay of the tail can decode from
+    uint64_t nowUs = steadyNowUs();
+    if ((packet->flags & AV_PKT_FLAG_KEY) || nowUs - lastFlushUs_ >= kFlushIntervalUs) {
+        lastFlushUs_ = nowUs;
+        return fflush(file_) == 0;
+    }
+    return true;
+}
+
+void PacketRecorder::close() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+PacketReplay::~PacketReplay() {
+    if (file_) fclose(file_);
+}
+
+bool PacketReplay::open(const std::string& path) {
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) return false;
+
+    char magic[sizeof(kMagic)];
+    int32_t codecId, width, height, format, colorRange, tbNum, tbDen;
+    uint32_t extradataSize;
+    if (fread(magic, sizeof(magic), 1, file_) != 1 || memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !readValue(file_, codecId) || !readValue(file_, width) || !readValue(file_, height) ||
+        !readValue(file_, format) || !readValue(file_, colorRange) ||
+        !readValue(file_, tbNum) || !readValue(file_, tbDen) || !readValue(file_, extradataSize)) {
+        return false;
+    }
+
+    codecpar_.reset(avcodec_parameters_alloc());
+    if (!codecpar_) return false;
+    codecpar_->codec_type = AVMEDIA_TYPE_VIDEO;
+    codecpar_->codec_id = static_cast<AVCodecID>(codecId);
+    codecpar_->width = width;
+    codecpar_->height = height;
+    codecpar_->format = format;
+    codecpar_->color_range = static_cast<AVColorRange>(colorRange);
+    timebase_ = AVRational{tbNum, tbDen};
+
+    if (extradataSize > 0) {
+        // Freed with the parameters by avcodec_parameters_free
+        codecpar_->extradata = static_cast<uint8_t*>(
+            av_mallocz(extradataSize + AV_INPUT_BUFFER_PADDING_SIZE));
+        if (!codecpar_->extradata ||
+            fread(codecpar_->extradata, extradataSize, 1, file_) != 1) {
+            return false;
+        }
+        codecpar_->extradata_size = static_cast<int>(extradataSize);
+    }
+    return true;
+}
+
+bool PacketReplay::read(AVPacket* packet, uint64_t& arrivalUs) {
+    if (!file_) return false;
+
+    int64_t pts, dts;
+    int32_t flags;
+    uint32_t size;
+    if (!readValue(file_, arrivalUs) || !readValue(file_, pts) || !readValue(file_, dts) ||
+        !readValue(file_, flags) || !readValue(file_, size)) {
+        return false;
+    }
+
+    if (av_new_packet(packet, static_cast<int>(size)) < 0) return false;
+    if (size > 0 && fread(packet->data, size, 1, file_) != 1) {
+        av_packet_unref(packet);
+        return false;
+    }
+    packet->pts = pts;
+    packet->dts = dts;
+    packet->flags = flags;
+    packet->stream_index = 0;
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "FFmpegHandles.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Recording file layout (host byte order):
+//
+//   header:  "CAMREC01", codec id, width, height, pixel format, color range,
+//            timebase num/den (int32 each), extradata size (uint32), extradata
+//   packet:  arrival time us (uint64), pts, dts (int64), flags (int32),
+//            size (uint32), payload
+//
+// Packets are the demuxed video packets, i.e. after RTP depacketization, with
+// the wall-clock time they left av_read_frame().
+
+// Appends demuxed video packets and their arrival times to a recording.
+// The file is flushed at every keyframe and at least once a second, so a
+// crash or kill loses at most the last second before it.
+class PacketRecorder {
+public:
+    PacketRecorder() = default;
+    ~PacketRecorder();
+
+    PacketRecorder(const PacketRecorder&) = delete;
+    PacketRecorder& operator=(const PacketRecorder&) = delete;
+
+    bool open(const std::string& path, const AVCodecParameters* codecpar, AVRational timebase);
+    bool write(const AVPacket* packet, uint64_t arrivalUs);
+    void close();
+
+    uint64_t packetsWritten() const { return packets_; }
+
+private:
+    FILE* file_ = nullptr;
+    uint64_t packets_ = 0;
+    uint64_t lastFlushUs_ = 0;      // Steady clock
+};
+
+// Reads a recording back as a packet source
+class PacketReplay {
+public:
+    PacketReplay() = default;
+    ~PacketReplay();
+
+    PacketReplay(const PacketReplay&) = delete;
+    PacketReplay& operator=(const PacketReplay&) = delete;
+
+    bool open(const std::string& path);
+
+    // Next packet and its recorded arrival time; false at the end of the recording
+    bool read(AVPacket* packet, uint64_t& arrivalUs);
+
+    const AVCodecParameters* codecParameters() const { return codecpar_.get(); }
+    AVRational timebase() const { return timebase_; }
+
+private:
+    FILE* file_ = nullptr;
+    CodecParametersPtr codecpar_;
+    AVRational timebase_{1, 90000};
+};
@@ -0,0 +1,307 @@
+#include "PreviewServer.hpp"
+#include "Frame.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kPollTimeoutMs = 10;
+constexpr size_t kMaxRequestBytes = 4096;
+
+// A connection that has not sent a complete request (or taken its error
+// response) by then is closed, so idle sockets cannot hold maxClients slots
+constexpr uint64_t kRequestTimeoutUs = 5000000;
+
+const char kStreamResponse[] =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+    "Cache-Control: no-cache, no-store\r\n"
+    "Pragma: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+const char kNotFoundResponse[] =
+    "HTTP/1.0 404 Not Found\r\n"
+    "Content-Type: text/plain\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Stream is at /stream.mjpg\r\n";
+
+const char kBadMethodResponse[] =
+    "HTTP/1.0 405 Method Not Allowed\r\n"
+    "Allow: GET\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+// Value of `key` in a query string such as "fps=2&x=1"; empty if missing
+std::string queryValue(const std::string& query, const std::string& key) {
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) end = query.size();
+        std::string pair = query.substr(pos, end - pos);
+        if (pair.compare(0, key.size() + 1, key + "=") == 0) {
+            return pair.substr(key.size() + 1);
+        }
+        pos = end + 1;
+    }
+    return "";
+}
+
+}  // namespace
+
+PreviewServer::PreviewServer(const PreviewOptions& options, FrameSource source)
+    : options_(options),
+      source_(std::move(source)) {
+}
+
+PreviewServer::~PreviewServer() {
+    stop();
+}
+
+bool PreviewServer::start() {
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        lastError_ = std::string("Preview server socket failed: ") + std::strerror(errno);
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+    if (inet_pton(AF_INET, options_.bindAddress.c_str(), &addr.sin_addr) != 1) {
+        lastError_ = "Invalid preview bind address: " + options_.bindAddress;
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listenFd_, 16) < 0) {
+        lastError_ = "Preview server failed to listen on " + options_.bindAddress + ":" +
+                     std::to_string(options_.port) + ": " + std::strerror(errno);
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    stop_.store(false);
+    thread_ = std::thread(&PreviewServer::serverThreadFunc, this);
+    Log::info("Preview server on http://{}:{}/stream.mjpg", options_.bindAddress, options_.port);
+    return true;
+}
+
+void PreviewServer::stop() {
+    stop_.store(true);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (auto& client : clients_) {
+        if (client.fd >= 0) close(client.fd);
+    }
+    clients_.clear();
+    clientCount_.store(0);
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+    }
+}
+
+void PreviewServer::acceptClients() {
+    while (true) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;  // EAGAIN: no more pending connections
+
+        if (static_cast<int>(clients_.size()) >= options_.maxClients) {
+            close(fd);
+            continue;
+        }
+        Client client;
+        client.fd = fd;
+        client.acceptedUs = steadyTimeUs();
+        clients_.push_back(std::move(client));
+    }
+}
+
+bool PreviewServer::readRequest(Client& client) {
+    char buffer[1024];
+    ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (received == 0) return false;
+    if (received < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    // Viewers never send anything after the request
+    if (client.streaming || !client.head.empty()) return true;
+
+    client.request.append(buffer, static_cast<size_t>(received));
+    if (client.request.find("\r\n\r\n") == std::string::npos) {
+        return client.request.size() < kMaxRequestBytes;
+    }
+
+    // "GET /stream.mjpg?fps=2 HTTP/1.1"
+    std::string line = client.request.substr(0, client.request.find("\r\n"));
+    size_t methodEnd = line.find(' ');
+    size_t targetEnd = line.find(' ', methodEnd + 1);
+    std::string method = line.substr(0, methodEnd);
+    std::string target = methodEnd == std::string::npos ? "" :
+                         line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    client.request.clear();
+
+    if (method != "GET") {
+        client.head = kBadMethodResponse;
+        return true;
+    }
+
+    size_t queryStart = target.find('?');
+    std::string path = target.substr(0, queryStart);
+    std::string query = queryStart == std::string::npos ? "" : target.substr(queryStart + 1);
+    if (path != "/" && path != "/stream.mjpg") {
+        client.head = kNotFoundResponse;
+        return true;
+    }
+
+    // A client may ask for less than the server limit, never more
+    double fps = options_.maxFps;
+    std::string requested = queryValue(query, "fps");
+    if (!requested.empty()) {
+        double value = std::atof(requested.c_str());
+        if (value > 0.0) fps = std::min(fps, value);
+    }
+    client.intervalUs = fps > 0.0 ? static_cast<uint64_t>(1e6 / fps) : 0;
+    client.streaming = true;
+    client.head = kStreamResponse;
+    clientCount_.fetch_add(1);
+    return true;
+}
+
+bool PreviewServer::flush(Client& client) {
+    while (client.pending()) {
+        size_t dataSize = client.frame ? client.frame->data->size() : 0;
+        size_t tailSize = strlen(client.tail);
+        size_t lengths[3] = {client.head.size(), dataSize, tailSize};
+        const void* bases[3] = {client.head.data(),
+                                client.frame ? client.frame->data->data() : nullptr,
+                                client.tail};
+
+        // Skip what is already sent; the frame bytes are never copied
+        iovec iov[3];
+        int count = 0;
+        size_t skip = client.sent;
+        for (int i = 0; i < 3; ++i) {
+            if (skip >= lengths[i]) {
+                skip -= lengths[i];
+                continue;
+            }
+            iov[count].iov_base = const_cast<char*>(static_cast<const char*>(bases[i]) + skip);
+            iov[count].iov_len = lengths[i] - skip;
+            skip = 0;
+            count++;
+        }
+
+        if (count > 0) {
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t sent = sendmsg(client.fd, &msg, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            client.sent += static_cast<size_t>(sent);
+            if (client.sent < lengths[0] + lengths[1] + lengths[2]) continue;
+        }
+
+        if (client.frame) framesSent_.fetch_add(1);
+        client.head.clear();
+        client.frame.reset();
+        client.tail = "";
+        client.sent = 0;
+
+        // Error responses end the connection once delivered
+        if (!client.streaming) return false;
+    }
+    return true;
+}
+
+void PreviewServer::queueFrame(Client& client, uint64_t nowUs) {
+    if (!client.streaming || client.pending() || nowUs < client.nextDueUs) return;
+
+    std::shared_ptr<const LatestFrame> frame = source_();
+    if (!frame || frame->format != FrameFormat::Jpeg ||
+        frame->frameNumber == client.lastFrameNumber) {
+        return;
+    }
+
+    client.head = "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " +
+                  std::to_string(frame->data->size()) + "\r\n\r\n";
+    client.frame = std::move(frame);
+    client.tail = "\r\n";
+    client.lastFrameNumber = client.frame->frameNumber;
+    client.nextDueUs = nowUs + client.intervalUs;
+}
+
+void PreviewServer::serverThreadFunc() {
+    Log::setThreadName("preview");
+    std::vector<pollfd> fds;
+
+    while (!stop_.load()) {
+        fds.clear();
+        fds.push_back({listenFd_, POLLIN, 0});
+        for (const auto& client : clients_) {
+            short events = POLLIN;
+            if (client.pending()) events |= POLLOUT;
+            fds.push_back({client.fd, events, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), kPollTimeoutMs) < 0 && errno != EINTR) {
+            Log::error("Preview server poll failed: {}", std::strerror(errno));
+            break;
+        }
+
+        // Clients accepted now are not in fds yet; they are polled next round
+        size_t polled = clients_.size();
+        if (fds[0].revents & POLLIN) {
+            acceptClients();
+        }
+
+        uint64_t nowUs = steadyTimeUs();
+        for (size_t i = 0; i < clients_.size(); ++i) {
+            Client& client = clients_[i];
+            bool keep = true;
+            if (i < polled) {
+                short revents = fds[i + 1].revents;
+                if (revents & (POLLERR | POLLHUP | POLLNVAL)) keep = false;
+                if (keep && (revents & POLLIN)) keep = readRequest(client);
+            }
+            if (keep && !client.streaming && nowUs > client.acceptedUs + kRequestTimeoutUs) {
+                keep = false;
+            }
+            if (keep) {
+                queueFrame(client, nowUs);
+                if (client.pending()) keep = flush(client);
+            }
+            if (!keep) {
+                if (client.streaming) clientCount_.fetch_sub(1);
+                close(client.fd);
+                client.fd = -1;
+            }
+        }
+
+        clients_.erase(std::remove_if(clients_.begin(), clients_.end(),
+                                      [](const Client& client) { return client.fd < 0; }),
+                       clients_.end());
+    }
+}
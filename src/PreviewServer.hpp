@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP server streaming multipart/x-mixed-replace MJPEG to browsers
+// and VLC. It serves the JPEGs the pipeline already produced, so viewers
+// cost no encoding: one thread polls every client socket and hands each the
+// newest frame when its rate limit allows. Slow clients skip frames instead
+// of queueing them.
+class PreviewServer {
+public:
+    using FrameSource = std::function<std::shared_ptr<const LatestFrame>()>;
+
+    PreviewServer(const PreviewOptions& options, FrameSource source);
+    ~PreviewServer();
+
+    PreviewServer(const PreviewServer&) = delete;
+    PreviewServer& operator=(const PreviewServer&) = delete;
+
+    // Bind, listen and start the server thread. Returns false on failure;
+    // see lastError().
+    bool start();
+    void stop();
+
+    const std::string& lastError() const { return lastError_; }
+    int clientCount() const { return clientCount_.load(); }
+    uint64_t framesSent() const { return framesSent_.load(); }
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string request;              // Request bytes until the blank line
+        uint64_t acceptedUs = 0;          // For the request timeout
+        bool streaming = false;
+        uint64_t intervalUs = 0;          // Per-client rate limit
+        uint64_t nextDueUs = 0;
+        uint64_t lastFrameNumber = UINT64_MAX;
+
+        // Pending output: head, then frame->data, then tail; `sent` spans all three
+        std::string head;
+        std::shared_ptr<const LatestFrame> frame;
+        const char* tail = "";
+        size_t sent = 0;
+
+        bool pending() const { return !head.empty() || frame; }
+    };
+
+    void serverThreadFunc();
+    void acceptClients();
+    bool readRequest(Client& client);
+    bool flush(Client& client);
+    void queueFrame(Client& client, uint64_t nowUs);
+
+    PreviewOptions options_;
+    FrameSource source_;
+    int listenFd_ = -1;
+    std::vector<Client> clients_;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<int> clientCount_{0};
+    std::atomic<uint64_t> framesSent_{0};
+    std::string lastError_;
+};
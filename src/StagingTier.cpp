@@ -0,0 +1,402 @@
+#include "StagingTier.hpp"
+#include "FileOutput.hpp"
+#include "Frame.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A file that keeps failing to migrate is left in the staging folder after
+// this many passes so it cannot hold up the files behind it
+constexpr int kMaxMigrationAttempts = 5;
+
+// Cross-filesystem copies read a run of files up to this size from staging,
+// then write them out back to back
+constexpr size_t kCopyRunBytes = 16u << 20;
+
+// From linux/ioprio.h, which glibc does not wrap
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioClassShift = 13;
+
+// Migration must never compete with the capture and write threads: lowest
+// CPU priority and idle I/O class for this thread only
+void lowerThreadPriority() {
+    pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << kIoprioClassShift);
+#endif
+}
+
+// Append the contents of filepath to data. Returns false with errno set.
+bool appendFileContents(const std::string& filepath, std::vector<uint8_t>& data) {
+    int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    size_t start = data.size();
+    size_t size = static_cast<size_t>(st.st_size);
+    data.resize(start + size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = read(fd, data.data() + start + done, size - done);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) {
+            int error = ret < 0 ? errno : EIO;     // Shrunk while reading
+            close(fd);
+            data.resize(start);
+            errno = error;
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    close(fd);
+    return true;
+}
+
+// Captures may share one staging folder; each gets a subfolder named after
+// its output folder, which is stable across restarts so a capture adopts only
+// its own leftovers
+std::string captureSubfolder(const std::string& outputFolder) {
+    std::error_code ec;
+    std::string path = fs::weakly_canonical(outputFolder, ec).string();
+    if (ec || path.empty()) path = outputFolder;
+
+    uint64_t hash = 14695981039346656037ull;     // FNV-1a
+    for (unsigned char c : path) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "capture-%016llx", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+}  // namespace
+
+StagingTier::StagingTier(const std::string& outputFolder, const StagingOptions& options,
+                         FrameNotifier* notifier)
+    : stagingFolder_(options.stagingFolder + "/" + captureSubfolder(outputFolder)),
+      outputFolder_(outputFolder),
+      options_(options),
+      notifier_(notifier) {
+}
+
+StagingTier::~StagingTier() {
+    stop();
+}
+
+bool StagingTier::start() {
+    std::error_code ec;
+    fs::create_directories(stagingFolder_, ec);
+    if (ec) {
+        lastError_ = "Failed to create staging folder " + stagingFolder_ + ": " + ec.message();
+        return false;
+    }
+
+    // Two captures writing to the same output folder would share a subfolder
+    std::string lockPath = stagingFolder_ + "/.lock";
+    lockFd_ = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd_ < 0 || flock(lockFd_, LOCK_EX | LOCK_NB) < 0) {
+        lastError_ = errno == EWOULDBLOCK
+                         ? "Staging folder " + stagingFolder_ + " is in use by another capture"
+                         : "Failed to lock staging folder " + stagingFolder_ + ": " +
+                               std::strerror(errno);
+        if (lockFd_ >= 0) close(lockFd_);
+        lockFd_ = -1;
+        return false;
+    }
+
+    // Files left behind by a run that did not finish migrating go first, to
+    // the root they were staged for if it is still there. Dot-files are the
+    // lock, the destinations and unpublished temp files, never stills.
+    std::unordered_map<std::string, std::string> destinations = readDestinations();
+    std::vector<StagedFile> leftover;
+    for (const auto& entry : fs::directory_iterator(stagingFolder_, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        std::string name = entry.path().filename().string();
+        if (name[0] == '.') continue;
+        std::string destination = outputFolder_;
+        auto it = destinations.find(name);
+        if (it != destinations.end()) {
+            if (fs::is_directory(it->second, ec)) {
+                destination = it->second;
+            } else {
+                Log::warning("Staging: root {} of {} is gone, migrating to {}", it->second, name,
+                             outputFolder_);
+            }
+        }
+        StagedFile file{name, destination, entry.file_size(ec), 0, {}};
+        file.notice.kind = "recovered";
+        file.notice.bytes = file.bytes;
+        leftover.push_back(std::move(file));
+    }
+
+    // Appended to, not truncated: entries for the leftovers stay until they
+    // are migrated
+    std::string destinationsPath = stagingFolder_ + "/.destinations";
+    destinationsFd_ = open(destinationsPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (destinationsFd_ < 0) {
+        Log::warning("Staging: failed to open {}: {}", destinationsPath, std::strerror(errno));
+    }
+    std::sort(leftover.begin(), leftover.end(),
+              [](const StagedFile& a, const StagedFile& b) { return a.name < b.name; });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+        for (auto& file : leftover) {
+            reservedBytes_ += file.bytes;
+            committedBytes_ += file.bytes;
+            staged_.push_back(std::move(file));
+        }
+        stagedFiles_.store(staged_.size());
+    }
+    if (!leftover.empty()) {
+        Log::info("Staging: migrating {} files left from a previous run", leftover.size());
+    }
+
+    migrationThread_ = std::thread(&StagingTier::migrationThreadFunc, this);
+    return true;
+}
+
+void StagingTier::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (migrationThread_.joinable()) {
+        migrationThread_.join();
+    }
+    if (destinationsFd_ >= 0) {
+        close(destinationsFd_);
+        destinationsFd_ = -1;
+    }
+    if (lockFd_ >= 0) {
+        close(lockFd_);
+        lockFd_ = -1;
+    }
+}
+
+bool StagingTier::reserve(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reservedBytes_ + bytes > options_.maxStagedBytes) {
+        overflows_.fetch_add(1);
+        return false;
+    }
+    reservedBytes_ += bytes;
+    return true;
+}
+
+void StagingTier::commit(const std::string& name, uint64_t bytes, const std::string& destination,
+                         const FrameNotice& notice) {
+    bool due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (destination != outputFolder_) recordDestination(name, destination);
+        staged_.push_back({name, destination, bytes, steadyTimeUs(), notice});
+        committedBytes_ += bytes;
+        stagedFiles_.store(staged_.size());
+        due = committedBytes_ >= options_.batchBytes;
+    }
+    if (due) cv_.notify_one();
+}
+
+void StagingTier::cancel(uint64_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reservedBytes_ -= std::min(bytes, reservedBytes_);
+}
+
+bool StagingTier::batchDue() const {
+    if (staged_.empty()) return false;
+    if (stopping_ || committedBytes_ >= options_.batchBytes) return true;
+    uint64_t ageUs = steadyTimeUs() - staged_.front().stagedTimeUs;
+    return ageUs >= static_cast<uint64_t>(options_.batchIntervalMs) * 1000;
+}
+
+void StagingTier::recordDestination(const std::string& name, const std::string& destination) {
+    if (destinationsFd_ < 0) return;
+    std::string line = name + "\t" + destination + "\n";
+    if (write(destinationsFd_, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+        Log::warning("Staging: failed to record the destination of {}", name);
+    }
+}
+
+std::unordered_map<std::string, std::string> StagingTier::readDestinations() const {
+    std::unordered_map<std::string, std::string> destinations;
+    std::ifstream in(stagingFolder_ + "/.destinations");
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || tab == 0) continue;   // Torn by a crash
+        destinations[line.substr(0, tab)] = line.substr(tab + 1);
+    }
+    return destinations;
+}
+
+void StagingTier::migrateBatch(const std::deque<StagedFile>& batch, std::vector<int>& results) {
+    results.assign(batch.size(), 0);
+
+    // Same filesystem: a rename is all it takes. Once a destination reports
+    // EXDEV, the rest of its files skip the rename and join the copy run.
+    std::vector<std::string> crossDevice;
+    std::vector<size_t> run;
+    uint64_t runBytes = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const StagedFile& file = batch[i];
+        bool copy = std::find(crossDevice.begin(), crossDevice.end(), file.destination) !=
+                    crossDevice.end();
+        if (!copy) {
+            std::string from = stagingFolder_ + "/" + file.name;
+            std::string to = file.destination + "/" + file.name;
+            if (std::rename(from.c_str(), to.c_str()) == 0) continue;
+            if (errno != EXDEV) {
+                results[i] = errno;
+                continue;
+            }
+            crossDevice.push_back(file.destination);
+        }
+
+        if (!run.empty() && runBytes + file.bytes > kCopyRunBytes) {
+            copyRun(batch, run, results);
+            run.clear();
+            runBytes = 0;
+        }
+        run.push_back(i);
+        runBytes += file.bytes;
+    }
+    if (!run.empty()) copyRun(batch, run, results);
+}
+
+void StagingTier::copyRun(const std::deque<StagedFile>& batch, const std::vector<size_t>& run,
+                          std::vector<int>& results) {
+    // Read the whole run from staging first so the output disk sees the
+    // writes back to back
+    std::vector<size_t> offsets;
+    offsets.reserve(run.size() + 1);
+    copyBuffer_.clear();
+    for (size_t i : run) {
+        offsets.push_back(copyBuffer_.size());
+        if (!appendFileContents(stagingFolder_ + "/" + batch[i].name, copyBuffer_)) {
+            results[i] = errno;
+        }
+    }
+    offsets.push_back(copyBuffer_.size());
+
+    // Each file is published in one step, so readers of the output folder
+    // only ever see complete files
+    for (size_t k = 0; k < run.size(); ++k) {
+        size_t i = run[k];
+        if (results[i] != 0) continue;
+        const StagedFile& file = batch[i];
+        if (!publishFileContents(file.destination + "/" + file.name,
+                                 copyBuffer_.data() + offsets[k], offsets[k + 1] - offsets[k])) {
+            results[i] = errno;
+            continue;
+        }
+        unlink((stagingFolder_ + "/" + file.name).c_str());
+    }
+}
+
+void StagingTier::migrationThreadFunc() {
+    Log::setThreadName("staging");
+    lowerThreadPriority();
+
+    std::deque<StagedFile> batch;
+    std::vector<int> results;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        // Wake at least every interval so old files do not wait for a full batch
+        cv_.wait_for(lock, std::chrono::milliseconds(std::max(options_.batchIntervalMs, 10)),
+                     [this] { return stopping_ || batchDue(); });
+        if (!batchDue()) {
+            if (stopping_) break;
+            continue;
+        }
+
+        batch.swap(staged_);
+        committedBytes_ = 0;
+        lock.unlock();
+
+        // One sequential pass over the batch, oldest first. A file that
+        // fails does not hold up the ones behind it.
+        migrateBatch(batch, results);
+        uint64_t doneBytes = 0;
+        std::deque<StagedFile> retry;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            StagedFile& file = batch[i];
+            int error = results[i];
+            if (error == 0) {
+                doneBytes += file.bytes;
+                migratedFiles_.fetch_add(1);
+                if (notifier_) {
+                    file.notice.path = file.destination + "/" + file.name;
+                    notifier_->send(file.notice);
+                }
+                continue;
+            }
+
+            migrationErrors_.fetch_add(1);
+            if (error == ENOENT && access((stagingFolder_ + "/" + file.name).c_str(), F_OK) != 0) {
+                Log::warning("Staging: {} disappeared before migration", file.name);
+                doneBytes += file.bytes;
+            } else if (++file.attempts >= kMaxMigrationAttempts) {
+                Log::error("Staging: giving up on {} after {} attempts, left in {}: {}", file.name,
+                           file.attempts, stagingFolder_, std::strerror(error));
+                doneBytes += file.bytes;
+            } else {
+                Log::error("Staging: failed to migrate {}: {}", file.name, std::strerror(error));
+                retry.push_back(std::move(file));
+            }
+        }
+
+        lock.lock();
+        reservedBytes_ -= std::min(doneBytes, reservedBytes_);
+
+        // Unmigrated files go back in front of anything staged meanwhile
+        for (auto it = retry.rbegin(); it != retry.rend(); ++it) {
+            committedBytes_ += it->bytes;
+            staged_.push_front(std::move(*it));
+        }
+        batch.clear();
+        stagedFiles_.store(staged_.size());
+
+        // Nothing left to send anywhere: start the destinations afresh
+        if (staged_.empty() && destinationsFd_ >= 0 && ftruncate(destinationsFd_, 0) != 0) {
+            Log::warning("Staging: failed to truncate {}/.destinations", stagingFolder_);
+        }
+
+        if (!retry.empty()) {
+            // Leave the rest staged (adopted by the next start) rather than
+            // spin on a full or missing output volume
+            if (stopping_) break;
+            cv_.wait_for(lock, std::chrono::seconds(1), [this] { return stopping_; });
+        }
+    }
+
+    if (!staged_.empty()) {
+        Log::warning("Staging: {} files left in {}", staged_.size(), stagingFolder_);
+    }
+}
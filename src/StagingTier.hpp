@@ -0,0 +1,103 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+#include "FrameNotifier.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Fast first tier for JPEG stills: writers land files in a bounded staging
+// folder (tmpfs / RAM disk) and a low-priority thread moves them to the
+// output folder in batches, oldest first. While the tier has headroom,
+// writer latency no longer depends on the output disk.
+class StagingTier {
+public:
+    // notifier (optional) announces each file once it reaches its destination
+    StagingTier(const std::string& outputFolder, const StagingOptions& options,
+                FrameNotifier* notifier = nullptr);
+    ~StagingTier();
+
+    StagingTier(const StagingTier&) = delete;
+    StagingTier& operator=(const StagingTier&) = delete;
+
+    // Create and lock this capture's subfolder of the staging folder, adopt
+    // files left there by an earlier run and start the migration thread
+    bool start();
+
+    // Migrate everything still staged, then stop the migration thread
+    void stop();
+
+    // Claim room for a file of `bytes`; false when the tier is full and the
+    // file should go straight to the output folder
+    bool reserve(uint64_t bytes);
+
+    // A reserved file is complete in folder() under `name` and belongs in
+    // `destination` (the output folder or a striping root). `notice` is sent
+    // with its final path after migration.
+    void commit(const std::string& name, uint64_t bytes, const std::string& destination,
+                const FrameNotice& notice = FrameNotice());
+
+    // A reserved file was not written
+    void cancel(uint64_t bytes);
+
+    const std::string& folder() const { return stagingFolder_; }
+    const std::string& lastError() const { return lastError_; }
+
+    uint64_t stagedFiles() const { return stagedFiles_.load(); }
+    uint64_t migratedFiles() const { return migratedFiles_.load(); }
+    uint64_t overflows() const { return overflows_.load(); }
+    uint64_t migrationErrors() const { return migrationErrors_.load(); }
+
+private:
+    struct StagedFile {
+        std::string name;
+        std::string destination;
+        uint64_t bytes;
+        uint64_t stagedTimeUs;
+        FrameNotice notice;
+        int attempts = 0;               // Failed migrations so far
+    };
+
+    void migrationThreadFunc();
+    bool batchDue() const;
+
+    // Migrate every file of the batch; results[i] is 0 or the errno of file i
+    void migrateBatch(const std::deque<StagedFile>& batch, std::vector<int>& results);
+    void copyRun(const std::deque<StagedFile>& batch, const std::vector<size_t>& run,
+                 std::vector<int>& results);
+
+    // Destinations other than the output folder, as "name\tdestination" lines
+    // in the subfolder's .destinations, so leftovers go back to their root
+    void recordDestination(const std::string& name, const std::string& destination);
+    std::unordered_map<std::string, std::string> readDestinations() const;
+
+    std::string stagingFolder_;
+    std::string outputFolder_;
+    StagingOptions options_;
+    FrameNotifier* notifier_;
+    std::string lastError_;
+    int lockFd_ = -1;                   // flock() on the subfolder's .lock while running
+    int destinationsFd_ = -1;           // .destinations, appended under mutex_
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<StagedFile> staged_;     // Committed, oldest first
+    uint64_t reservedBytes_ = 0;        // Committed plus in-flight writes
+    uint64_t committedBytes_ = 0;
+    bool stopping_ = false;
+    std::thread migrationThread_;
+
+    std::vector<uint8_t> copyBuffer_;   // Cross-filesystem copy runs (migration thread only)
+
+    std::atomic<uint64_t> stagedFiles_{0};
+    std::atomic<uint64_t> migratedFiles_{0};
+    std::atomic<uint64_t> overflows_{0};
+    std::atomic<uint64_t> migrationErrors_{0};
+};
@@ -0,0 +1,326 @@
+#include "StereoCompositeSink.hpp"
+#include "FrameKernels.hpp"
+#include "FrameIndex.hpp"
+#include "FileOutput.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Place two equally sized raw frames next to each other, plane by plane
+bool composeFrames(const Frame& first, const Frame& second, CompositeLayout layout, Frame& out) {
+    if (first.format != second.format || first.format == FrameFormat::Jpeg ||
+        first.width != second.width || first.height != second.height) {
+        return false;
+    }
+
+    bool sideBySide = layout == CompositeLayout::SideBySide;
+    bool planarYuv = first.format == FrameFormat::Yuv420 || first.format == FrameFormat::Yuv422;
+
+    // Subsampled chroma only splits cleanly along even sizes
+    if (planarYuv && sideBySide && first.width % 2 != 0) return false;
+    if (first.format == FrameFormat::Yuv420 && !sideBySide && first.height % 2 != 0) return false;
+
+    out.format = first.format;
+    out.width = sideBySide ? first.width * 2 : first.width;
+    out.height = sideBySide ? first.height : first.height * 2;
+    out.data.resize(frameDataSize(out.format, out.width, out.height));
+
+    FramePlanes a = framePlanes(first);
+    FramePlanes b = framePlanes(second);
+    FramePlanes o = framePlanes(out.format, out.data.data(), out.width, out.height);
+
+    for (int p = 0; p < a.count; ++p) {
+        uint8_t* dst = out.data.data() + (o.data[p] - o.data[0]);
+        size_t rowBytes = static_cast<size_t>(a.linesize[p]);
+        int rows = p == 0 ? first.height : a.chromaHeight;
+
+        if (sideBySide) {
+            for (int row = 0; row < rows; ++row) {
+                uint8_t* outRow = dst + static_cast<size_t>(row) * o.linesize[p];
+                memcpy(outRow, a.data[p] + row * rowBytes, rowBytes);
+                memcpy(outRow + rowBytes, b.data[p] + row * rowBytes, rowBytes);
+            }
+        } else {
+            // Tightly packed planes: each view is one contiguous block
+            memcpy(dst, a.data[p], rows * rowBytes);
+            memcpy(dst + rows * rowBytes, b.data[p], rows * rowBytes);
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+StereoCompositeSink::Impl::Impl(const std::string& outputFolder, const CompositeOptions& options)
+    : outputFolder_(outputFolder),
+      options_(options) {
+    try {
+        fs::create_directories(outputFolder_);
+    } catch (const std::exception& e) {
+        Log::error("Failed to create composite folder: {}", e.what());
+    }
+}
+
+StereoCompositeSink::Impl::~Impl() {
+    stop();
+}
+
+bool StereoCompositeSink::Impl::start() {
+    if (running_.exchange(true)) {
+        return false;
+    }
+    shouldStop_.store(false);
+
+    if (options_.frameIndexEnabled) {
+        frameIndex_ = std::make_unique<FrameIndex>(outputFolder_);
+    }
+
+    for (int i = 0; i < std::max(options_.encodeThreads, 1); ++i) {
+        encodeThreads_.emplace_back(&Impl::encodeThreadFunc, this);
+    }
+    return true;
+}
+
+void StereoCompositeSink::Impl::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+
+    shouldStop_.store(true);
+    pairsCv_.notify_all();
+    for (auto& thread : encodeThreads_) {
+        if (thread.joinable()) thread.join();
+    }
+    encodeThreads_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int view = 0; view < 2; ++view) {
+        for (Frame& frame : pending_[view]) {
+            recycleLocked(view, frame);
+        }
+        pending_[view].clear();
+    }
+    for (; !pairs_.empty(); pairs_.pop()) {
+        recycleLocked(0, pairs_.front().views[0]);
+        recycleLocked(1, pairs_.front().views[1]);
+    }
+    if (frameIndex_) {
+        frameIndex_->flush();
+        frameIndex_.reset();
+    }
+}
+
+uint64_t StereoCompositeSink::Impl::pairingTimeUs(const Frame& frame) const {
+    if (options_.useHardwareTime && frame.hwTimeValid) {
+        return frame.hardwareTimeNs / 1000;
+    }
+    return frame.computerTimeUs;
+}
+
+void StereoCompositeSink::Impl::setRelease(CompositeView view, ReleaseFn release) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    releases_[view == CompositeView::First ? 0 : 1] = std::move(release);
+}
+
+void StereoCompositeSink::Impl::recycleLocked(int view, Frame& frame) {
+    if (releases_[view]) {
+        releases_[view](frame);
+    }
+}
+
+void StereoCompositeSink::Impl::submit(CompositeView view, Frame&& frame) {
+    const int self = view == CompositeView::First ? 0 : 1;
+    if (!running_.load()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        recycleLocked(self, frame);
+        return;
+    }
+
+    const uint64_t skewUs = static_cast<uint64_t>(options_.maxSkewMs) * 1000;
+    const uint64_t timeUs = pairingTimeUs(frame);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::deque<Frame>& others = pending_[1 - self];
+
+    // Partners older than the skew window can no longer pair with anything
+    while (!others.empty() && pairingTimeUs(others.front()) + skewUs < timeUs) {
+        recycleLocked(1 - self, others.front());
+        others.pop_front();
+        unpaired_.fetch_add(1);
+    }
+
+    // Nearest waiting partner within the window
+    size_t best = others.size();
+    uint64_t bestSkew = skewUs + 1;
+    for (size_t i = 0; i < others.size(); ++i) {
+        uint64_t otherUs = pairingTimeUs(others[i]);
+        uint64_t skew = otherUs > timeUs ? otherUs - timeUs : timeUs - otherUs;
+        if (otherUs > timeUs + skewUs) break;
+        if (skew < bestSkew) {
+            bestSkew = skew;
+            best = i;
+        }
+    }
+
+    if (best == others.size()) {
+        std::deque<Frame>& own = pending_[self];
+        own.push_back(std::move(frame));
+        if (own.size() > kMaxPending) {
+            recycleLocked(self, own.front());
+            own.pop_front();
+            unpaired_.fetch_add(1);
+        }
+        return;
+    }
+
+    // Earlier waiting frames were passed over for a closer partner
+    for (size_t i = 0; i < best; ++i) {
+        recycleLocked(1 - self, others[i]);
+        unpaired_.fetch_add(1);
+    }
+    FramePair pair;
+    pair.views[self] = std::move(frame);
+    pair.views[1 - self] = std::move(others[best]);
+    pair.skewUs = bestSkew;
+    pair.queuedTimeUs = steadyTimeUs();
+    others.erase(others.begin(), others.begin() + best + 1);
+
+    pairCount_.fetch_add(1);
+    skewSumUs_.fetch_add(bestSkew);
+
+    if (pairs_.size() >= kMaxQueuedPairs) {
+        recycleLocked(0, pair.views[0]);
+        recycleLocked(1, pair.views[1]);
+        droppedPairs_.fetch_add(1);
+        return;
+    }
+    pairs_.push(std::move(pair));
+    lock.unlock();
+    pairsCv_.notify_one();
+}
+
+void StereoCompositeSink::Impl::encodeThreadFunc() {
+    Log::setThreadName("composite encoder");
+    Frame composite;
+    std::vector<uint8_t> jpeg;
+
+    while (!shouldStop_.load()) {
+        FramePair pair;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!pairsCv_.wait_for(lock, std::chrono::milliseconds(100),
+                                   [this] { return !pairs_.empty() || shouldStop_.load(); })) {
+                continue;
+            }
+            if (pairs_.empty()) continue;
+            pair = std::move(pairs_.front());
+            pairs_.pop();
+        }
+
+        const Frame& first = pair.views[0];
+        const Frame& second = pair.views[1];
+
+        FrameTiming timing;
+        uint64_t composeStartUs = steadyTimeUs();
+        timing.queueWaitUs = composeStartUs - pair.queuedTimeUs;
+
+        EncodeFn encode = encoderForFormat(first.format);
+        bool composed = encode && composeFrames(first, second, options_.layout, composite);
+
+        // The views' pixels are in the composite now; their frames go back
+        // to the captures
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            recycleLocked(0, pair.views[0]);
+            recycleLocked(1, pair.views[1]);
+        }
+        if (!composed) {
+            mismatched_.fetch_add(1);
+            continue;
+        }
+        if (!encode(composite, options_.jpegQuality, jpeg)) {
+            Log::error("Composite JPEG encode failed");
+            continue;
+        }
+
+        uint64_t writeStartUs = steadyTimeUs();
+        timing.encodeUs = writeStartUs - composeStartUs;
+
+        // Named after the first view's receive time and both hardware timestamps
+        std::ostringstream oss;
+        oss << formatComputerTime(first.computerTimeMs)
+            << "_HW_" << first.hardwareTimeNs << "_" << second.hardwareTimeNs << ".jpg";
+        std::string filename = oss.str();
+        std::string filepath = outputFolder_ + "/" + filename;
+
+        if (!publishFileContents(filepath, jpeg.data(), jpeg.size())) {
+            Log::error("Failed to write file: {}: {}", filepath, std::strerror(errno));
+            continue;
+        }
+        timing.writeUs = steadyTimeUs() - writeStartUs;
+        uint64_t sequence = written_.fetch_add(1);
+
+        if (frameIndex_) {
+            frameIndex_->append({
+                sequence,
+                first.computerTimeMs,
+                first.hardwareTimeNs,
+                first.hwTimeValid,
+                timing.latencyUs() / 1000,
+                timing,
+                first.packetTimeUs,
+                first.computerTimeUs,
+                systemTimeUs(),
+                jpeg.size(),
+                filename,
+                -1,
+                -1,
+                -1,
+                first.sei,
+                ImageStats{},
+                ""
+            });
+        }
+    }
+}
+
+CompositeStats StereoCompositeSink::Impl::stats() const {
+    uint64_t pairs = pairCount_.load();
+    return {
+        pairs,
+        written_.load(),
+        unpaired_.load(),
+        mismatched_.load(),
+        droppedPairs_.load(),
+        pairs ? skewSumUs_.load() / 1000.0f / pairs : 0.0f
+    };
+}
+
+StereoCompositeSink::StereoCompositeSink(const std::string& outputFolder,
+                                         const CompositeOptions& options)
+    : impl_(std::make_unique<Impl>(outputFolder, options)) {
+}
+
+StereoCompositeSink::~StereoCompositeSink() = default;
+
+bool StereoCompositeSink::start() {
+    return impl_->start();
+}
+
+void StereoCompositeSink::stop() {
+    impl_->stop();
+}
+
+CompositeStats StereoCompositeSink::getStats() const {
+    return impl_->stats();
+}
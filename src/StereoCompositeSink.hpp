@@ -0,0 +1,73 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+#include "Frame.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameIndex;
+
+// Pairs frames from the two views by timestamp and composes/encodes each
+// pair on a small pool of encode threads
+class StereoCompositeSink::Impl {
+public:
+    Impl(const std::string& outputFolder, const CompositeOptions& options);
+    ~Impl();
+
+    bool start();
+    void stop();
+
+    // Hands a view's frames back to the capture feeding it once they are
+    // composed or dropped; null detaches the capture (frames are then freed)
+    using ReleaseFn = std::function<void(Frame& frame)>;
+    void setRelease(CompositeView view, ReleaseFn release);
+
+    // Called by a capture's composite write thread for every decoded frame
+    void submit(CompositeView view, Frame&& frame);
+
+    CompositeStats stats() const;
+
+private:
+    struct FramePair {
+        Frame views[2];
+        uint64_t skewUs = 0;
+        uint64_t queuedTimeUs = 0;
+    };
+
+    static constexpr size_t kMaxPending = 8;       // Unpaired frames kept per view
+    static constexpr size_t kMaxQueuedPairs = 8;
+
+    uint64_t pairingTimeUs(const Frame& frame) const;
+    // Hand a frame back to its view's capture; mutex_ held
+    void recycleLocked(int view, Frame& frame);
+    void encodeThreadFunc();
+
+    std::string outputFolder_;
+    CompositeOptions options_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> shouldStop_{false};
+
+    std::mutex mutex_;
+    std::deque<Frame> pending_[2];
+    ReleaseFn releases_[2];
+    std::queue<FramePair> pairs_;
+    std::condition_variable pairsCv_;
+    std::vector<std::thread> encodeThreads_;
+    std::unique_ptr<FrameIndex> frameIndex_;
+
+    std::atomic<uint64_t> pairCount_{0};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> unpaired_{0};
+    std::atomic<uint64_t> mismatched_{0};
+    std::atomic<uint64_t> droppedPairs_{0};
+    std::atomic<uint64_t> skewSumUs_{0};
+};
@@ -0,0 +1,534 @@
+#include "StreamSession.hpp"
+#include "Log.hpp"
+#include "CpuAccounting.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/mathematics.h>
+}
+
+namespace {
+
+// Picture size from a JPEG's SOFn header; passthrough packets are never decoded
+bool jpegDimensions(const uint8_t* data, size_t size, int& width, int& height) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+
+    size_t i = 2;
+    while (i + 4 <= size) {
+        if (data[i] != 0xFF) return false;
+        uint8_t marker = data[i + 1];
+        if (marker == 0xFF) {  // Fill byte
+            i++;
+            continue;
+        }
+        bool isSof = marker >= 0xC0 && marker <= 0xCF &&
+                     marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (isSof) {
+            if (i + 9 > size) return false;
+            height = (data[i + 5] << 8) | data[i + 6];
+            width = (data[i + 7] << 8) | data[i + 8];
+            return true;
+        }
+        i += 2 + ((data[i + 2] << 8) | data[i + 3]);
+    }
+    return false;
+}
+
+} // namespace
+
+void PacketStatsAccumulator::add(const AVPacket* packet, AVRational timebase) {
+    uint32_t size = static_cast<uint32_t>(packet->size);
+    bool isKey = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+    packets_++;
+    bytes_ += size;
+    minBytes_ = std::min(minBytes_, size);
+    maxBytes_ = std::max(maxBytes_, size);
+    totalPackets_++;
+    totalBytes_ += size;
+
+    if (isKey) {
+        keyPackets_++;
+        keyBytes_ += size;
+        if (packetsSinceKey_ > 0) {
+            gopLength_ = static_cast<uint32_t>(packetsSinceKey_);
+        }
+        packetsSinceKey_ = 0;
+    } else {
+        deltaBytes_ += size;
+    }
+    if (sawKey_ || isKey) {
+        sawKey_ = true;
+        packetsSinceKey_++;
+    }
+
+    // PTS spacing (stream order, so B-frame reordering shows up as jitter)
+    if (packet->pts != AV_NOPTS_VALUE) {
+        if (lastPts_ != AV_NOPTS_VALUE) {
+            double deltaMs = (packet->pts - lastPts_) * av_q2d(timebase) * 1000.0;
+            ptsDeltaSum_ += deltaMs;
+            ptsDeltaSqSum_ += deltaMs * deltaMs;
+            ptsDeltaCount_++;
+        }
+        lastPts_ = packet->pts;
+    }
+}
+
+PacketStats PacketStatsAccumulator::flush(double elapsedSec) {
+    PacketStats stats{};
+    stats.intervalSec = static_cast<float>(elapsedSec);
+    stats.packets = packets_;
+    stats.keyPackets = keyPackets_;
+    stats.bitrateKbps = elapsedSec > 0.0
+        ? static_cast<float>(bytes_ * 8.0 / elapsedSec / 1000.0) : 0.0f;
+    stats.avgPacketBytes = packets_ ? static_cast<float>(bytes_) / packets_ : 0.0f;
+    stats.minPacketBytes = packets_ ? minBytes_ : 0;
+    stats.maxPacketBytes = maxBytes_;
+
+    uint64_t deltaPackets = packets_ - keyPackets_;
+    stats.avgKeyPacketBytes = keyPackets_ ? static_cast<float>(keyBytes_) / keyPackets_ : 0.0f;
+    stats.avgDeltaPacketBytes = deltaPackets ? static_cast<float>(deltaBytes_) / deltaPackets : 0.0f;
+    stats.keyToDeltaRatio = (keyPackets_ && deltaPackets)
+        ? stats.avgKeyPacketBytes / stats.avgDeltaPacketBytes : 0.0f;
+    stats.gopLength = gopLength_;
+
+    if (ptsDeltaCount_ > 0) {
+        double mean = ptsDeltaSum_ / ptsDeltaCount_;
+        double variance = ptsDeltaSqSum_ / ptsDeltaCount_ - mean * mean;
+        stats.avgPtsDeltaMs = static_cast<float>(mean);
+        stats.ptsJitterMs = static_cast<float>(std::sqrt(std::max(variance, 0.0)));
+    }
+
+    stats.totalPackets = totalPackets_;
+    stats.totalBytes = totalBytes_;
+
+    // Reset interval counters (GOP tracking and totals carry over)
+    packets_ = 0;
+    keyPackets_ = 0;
+    bytes_ = 0;
+    keyBytes_ = 0;
+    deltaBytes_ = 0;
+    minBytes_ = UINT32_MAX;
+    maxBytes_ = 0;
+    ptsDeltaSum_ = 0.0;
+    ptsDeltaSqSum_ = 0.0;
+    ptsDeltaCount_ = 0;
+    return stats;
+}
+
+StreamSession::StreamSession(const std::string& url, bool passthrough, bool grayscale)
+    : url_(url),
+      passthrough_(passthrough),
+      grayscale_(grayscale) {
+}
+
+const FrameKernels& StreamSession::selectKernels() const {
+    if (grayscale_) {
+        return selectGrayKernels(mode_.pixFmt, mode_.fullRange);
+    }
+    return selectFrameKernels(mode_.width, mode_.height, mode_.pixFmt, mode_.fullRange);
+}
+
+bool StreamSession::fail(ErrorType type, const std::string& message) {
+    errorType_ = type;
+    error_ = message;
+    return false;
+}
+
+void StreamSession::setRecording(const std::string& path) {
+    recordPath_ = path;
+}
+
+void StreamSession::setReplay(const std::string& path, bool realTime) {
+    replayPath_ = path;
+    replayRealTime_ = realTime;
+}
+
+bool StreamSession::openInput(const AVCodecParameters*& codecpar) {
+    if (!replayPath_.empty()) {
+        replay_ = std::make_unique<PacketReplay>();
+        if (!replay_->open(replayPath_)) {
+            return fail(ErrorType::ConnectionFailed, "Failed to open packet recording: " + replayPath_);
+        }
+        codecpar = replay_->codecParameters();
+        videoTimebase_ = replay_->timebase();
+        videoStreamIdx_ = 0;
+        return true;
+    }
+
+    // Set low latency options
+    AVDictionary* options = nullptr;
+    av_dict_set(&options, "rtsp_transport", "tcp", 0);
+    av_dict_set(&options, "buffer_size", "32768", 0);
+    av_dict_set(&options, "max_delay", "500000", 0);  // 500ms max delay
+
+    // avformat_open_input frees the context itself on failure
+    AVFormatContext* formatCtx = nullptr;
+    int ret = avformat_open_input(&formatCtx, url_.c_str(), nullptr, &options);
+    av_dict_free(&options);
+    if (ret != 0) {
+        return fail(ErrorType::ConnectionFailed, "Failed to open RTSP stream: " + url_);
+    }
+    formatCtx_.reset(formatCtx);
+
+    if (avformat_find_stream_info(formatCtx_.get(), nullptr) < 0) {
+        return fail(ErrorType::ConnectionFailed, "Failed to find stream info");
+    }
+
+    // Find video stream
+    for (unsigned int i = 0; i < formatCtx_->nb_streams; ++i) {
+        if (formatCtx_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            videoStreamIdx_ = i;
+            break;
+        }
+    }
+    if (videoStreamIdx_ < 0) {
+        return fail(ErrorType::ConnectionFailed, "No video stream found");
+    }
+
+    AVStream* stream = formatCtx_->streams[videoStreamIdx_];
+    videoTimebase_ = stream->time_base;
+    codecpar = stream->codecpar;
+    return true;
+}
+
+bool StreamSession::open() {
+    const AVCodecParameters* codecpar = nullptr;
+    if (!openInput(codecpar)) {
+        return false;
+    }
+
+    if (passthrough_ && codecpar->codec_id != AV_CODEC_ID_MJPEG) {
+        return fail(ErrorType::Other, "MJPEG passthrough requires an MJPEG stream");
+    }
+
+    if (!recordPath_.empty()) {
+        recorder_ = std::make_unique<PacketRecorder>();
+        if (!recorder_->open(recordPath_, codecpar, videoTimebase_)) {
+            return fail(ErrorType::WriteError, "Failed to create packet recording: " + recordPath_);
+        }
+    }
+
+    const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
+    if (!codec) {
+        return fail(ErrorType::FrameDecodeError, "Codec not found");
+    }
+
+    codecCtx_.reset(avcodec_alloc_context3(codec));
+    if (!codecCtx_) {
+        return fail(ErrorType::FrameDecodeError, "Failed to allocate codec context");
+    }
+
+    avcodec_parameters_to_context(codecCtx_.get(), codecpar);
+    codecCtx_->thread_count = 4;
+
+    // Decoder threads start here; they count toward this camera's decode stage
+    int opened;
+    {
+        CodecThreadScope decoderThreads(CpuStage::Decode);
+        opened = avcodec_open2(codecCtx_.get(), codec, nullptr);
+    }
+    if (opened < 0) {
+        return fail(ErrorType::FrameDecodeError, "Failed to open codec");
+    }
+
+    rawFrame_.reset(av_frame_alloc());
+    heldFrame_.reset(av_frame_alloc());
+    packet_.reset(av_packet_alloc());
+    if (!rawFrame_ || !heldFrame_ || !packet_) {
+        return fail(ErrorType::FrameDecodeError, "Failed to allocate frame buffers");
+    }
+
+    mode_ = {codecCtx_->width, codecCtx_->height, codecCtx_->pix_fmt,
+             codecCtx_->color_range == AVCOL_RANGE_JPEG};
+    kernels_ = &selectKernels();
+
+    lastPacketStatsUs_ = steadyTimeUs();
+    return true;
+}
+
+StageResult StreamSession::readReplayPacket(uint64_t& arrivalUs) {
+    uint64_t recordedUs = 0;
+    if (!replay_->read(packet_.get(), recordedUs)) {
+        fail(ErrorType::Other, "End of packet recording");
+        return StageResult::EndOfStream;
+    }
+
+    // A flat-out replay keeps no gaps; packets arrive when they are read
+    if (!replayRealTime_) {
+        arrivalUs = systemTimeUs();
+        return StageResult::Ok;
+    }
+
+    uint64_t nowUs = steadyTimeUs();
+    if (!replayStarted_) {
+        replayStartUs_ = nowUs;
+        replaySystemStartUs_ = systemTimeUs();
+        replayFirstUs_ = recordedUs;
+        replayStarted_ = true;
+    }
+
+    // Reproduce the recorded inter-arrival gaps against the steady clock
+    uint64_t offsetUs = recordedUs > replayFirstUs_ ? recordedUs - replayFirstUs_ : 0;
+    uint64_t dueUs = replayStartUs_ + offsetUs;
+    if (dueUs > nowUs) {
+        std::this_thread::sleep_for(std::chrono::microseconds(dueUs - nowUs));
+    }
+
+    // The recorded arrival, moved onto this run's clock, so it compares with
+    // the decode and commit times stamped during the replay
+    arrivalUs = replaySystemStartUs_ + offsetUs;
+    return StageResult::Ok;
+}
+
+StageResult StreamSession::demux() {
+    // A replay carries its recorded arrival gaps so packet timing is reproduced too
+    uint64_t arrivalUs = 0;
+    if (replay_) {
+        StageResult result = readReplayPacket(arrivalUs);
+        if (result != StageResult::Ok) return result;
+    } else if (av_read_frame(formatCtx_.get(), packet_.get()) < 0) {
+        fail(ErrorType::FrameDecodeError, "Failed to read frame");
+        return StageResult::Error;
+    } else {
+        arrivalUs = systemTimeUs();
+    }
+
+    if (packet_->stream_index != videoStreamIdx_) {
+        av_packet_unref(packet_.get());
+        return StageResult::Again;
+    }
+
+    packetArrivals_[packetArrivalNext_] = {packet_->pts, arrivalUs};
+    packetArrivalNext_ = (packetArrivalNext_ + 1) % kPacketArrivalSlots;
+
+    // A failing recording is abandoned; capture itself carries on
+    if (recorder_ && !recorder_->write(packet_.get(), arrivalUs)) {
+        Log::error("Packet recording stopped after {} packets: write failed",
+                   recorder_->packetsWritten());
+        recorder_.reset();
+    }
+
+    // Collect compressed stream statistics
+    packetAccumulator_.add(packet_.get(), videoTimebase_);
+
+    // After a pause, discard undecodable packets up to the next keyframe
+    if (awaitingKeyframe_) {
+        if (!(packet_->flags & AV_PKT_FLAG_KEY)) {
+            av_packet_unref(packet_.get());
+            return StageResult::Skipped;
+        }
+        awaitingKeyframe_ = false;
+    }
+
+    return StageResult::Ok;
+}
+
+StageResult StreamSession::decode() {
+    // MJPEG passthrough: every packet is a complete JPEG, skip decoding
+    if (passthrough_) return StageResult::Ok;
+
+    // The previous picture became the decimation candidate; receive into the old one
+    if (pendingHold_) {
+        std::swap(heldFrame_, rawFrame_);
+        heldDecodedUs_ = decodedTimeUs_;
+        av_frame_unref(rawFrame_.get());
+        pendingHold_ = false;
+    }
+
+    int ret = avcodec_send_packet(codecCtx_.get(), packet_.get());
+    av_packet_unref(packet_.get());
+    if (ret < 0) return StageResult::Again;
+
+    ret = avcodec_receive_frame(codecCtx_.get(), rawFrame_.get());
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return StageResult::Again;
+    if (ret < 0) {
+        fail(ErrorType::FrameDecodeError, "Decoding error");
+        return StageResult::Error;
+    }
+    decodedTimeUs_ = systemTimeUs();
+
+    // Cameras switch resolution or format when reconfigured; the kernels
+    // (some with compiled-in dimensions) must follow the decoded picture
+    StreamMode mode{rawFrame_->width, rawFrame_->height, rawFrame_->format,
+                    rawFrame_->color_range == AVCOL_RANGE_JPEG};
+    if (mode != mode_) {
+        rebuildStartUs_ = steadyTimeUs();
+        mode_ = mode;
+        kernels_ = &selectKernels();
+        convertScratch_.swsCtx.reset();
+        rebuildPending_ = true;
+        discardHeldFrame();  // Its planes no longer match the kernels
+    }
+    return StageResult::Ok;
+}
+
+void StreamSession::setDecimation(double outputFps, bool hardwareClock) {
+    decimator_ = std::make_unique<FrameDecimator>(outputFps);
+    decimateOnHardwareTime_ = hardwareClock;
+}
+
+int StreamSession::select() {
+    readyCount_ = 0;
+    readyNext_ = 0;
+
+    if (passthrough_ || !decimator_) {
+        ready_[readyCount_++] = {rawFrame_.get(), decodedTimeUs_};
+        return readyCount_;
+    }
+
+    int64_t timeUs = static_cast<int64_t>(decodedTimeUs_);
+    if (decimateOnHardwareTime_ && rawFrame_->pts != AV_NOPTS_VALUE) {
+        timeUs = av_rescale_q(rawFrame_->pts, videoTimebase_, AVRational{1, 1000000});
+    }
+
+    // Older picture first, so frame numbers and timestamps stay in order
+    FrameDecimator::Decision decision = decimator_->offer(timeUs);
+    if (decision.emitHeld) {
+        ready_[readyCount_++] = {heldFrame_.get(), heldDecodedUs_};
+    }
+    if (decision.emitCurrent) {
+        ready_[readyCount_++] = {rawFrame_.get(), decodedTimeUs_};
+    }
+    pendingHold_ = decision.holdCurrent;
+    return readyCount_;
+}
+
+bool StreamSession::convertLatest(Frame& frame) {
+    uint64_t nextFrameNumber = frameCounter_;
+    stampFrame(frame, rawFrame_->pts, decodedTimeUs_);
+    frameCounter_ = nextFrameNumber;
+
+    if (!kernels_->convert(rawFrame_.get(), frame, convertScratch_)) {
+        return fail(ErrorType::FrameDecodeError, "Failed to convert snapshot frame");
+    }
+    frame.kernels = kernels_;
+    return true;
+}
+
+void StreamSession::discardHeldFrame() {
+    if (!decimator_) return;
+    decimator_->discardHeld();
+    av_frame_unref(heldFrame_.get());
+    pendingHold_ = false;
+}
+
+bool StreamSession::convert(Frame& frame) {
+    if (passthrough_) {
+        frame.format = FrameFormat::Jpeg;
+        frame.width = mode_.width;
+        frame.height = mode_.height;
+
+        int width = 0;
+        int height = 0;
+        if (jpegDimensions(packet_->data, packet_->size, width, height) &&
+            (width != mode_.width || height != mode_.height)) {
+            mode_.width = frame.width = width;
+            mode_.height = frame.height = height;
+            lastRebuildUs_ = 0;  // Nothing to rebuild; the writer rolls its segment
+            modeChanged_ = true;
+        }
+
+        stampFrame(frame, packet_->pts, systemTimeUs());
+        frame.data.assign(packet_->data, packet_->data + packet_->size);
+        av_packet_unref(packet_.get());
+        return true;
+    }
+
+    const ReadyPicture& picture = ready_[readyNext_++];
+    const AVFrame* src = picture.frame;
+    stampFrame(frame, src->pts, picture.decodedTimeUs);
+
+    // Keep SEI user data the decoder attached to this picture
+    frame.sei.clear();
+    for (int i = 0; i < src->nb_side_data; ++i) {
+        const AVFrameSideData* sideData = src->side_data[i];
+        if (sideData->type == AV_FRAME_DATA_SEI_UNREGISTERED) {
+            appendSeiRecord(frame.sei, SeiUnregistered, sideData->data, sideData->size);
+        } else if (sideData->type == AV_FRAME_DATA_A53_CC) {
+            appendSeiRecord(frame.sei, SeiRegisteredItuT35, sideData->data, sideData->size);
+        }
+    }
+
+    // Convert decoded planes into the frame buffer
+    if (!kernels_->convert(src, frame, convertScratch_)) {
+        return fail(ErrorType::FrameDecodeError, "Failed to convert frame");
+    }
+    frame.kernels = kernels_;
+
+    // Rebuild cost includes the first convert: sws context setup and buffer growth
+    if (rebuildPending_) {
+        lastRebuildUs_ = steadyTimeUs() - rebuildStartUs_;
+        rebuildPending_ = false;
+        modeChanged_ = true;
+    }
+    return true;
+}
+
+bool StreamSession::takeModeChange() {
+    bool changed = modeChanged_;
+    modeChanged_ = false;
+    return changed;
+}
+
+bool StreamSession::takePacketStats(PacketStats& stats, int intervalMs) {
+    uint64_t now = steadyTimeUs();
+    uint64_t elapsedUs = now - lastPacketStatsUs_;
+    if (elapsedUs < static_cast<uint64_t>(intervalMs) * 1000) return false;
+
+    stats = packetAccumulator_.flush(elapsedUs / 1e6);
+    lastPacketStatsUs_ = now;
+    return true;
+}
+
+void StreamSession::pauseInput() {
+    // A replay simply is not read while paused
+    inputPaused_ = formatCtx_ && av_read_pause(formatCtx_.get()) >= 0;
+}
+
+void StreamSession::resumeInput() {
+    // RTSP sends PAUSE/PLAY; other inputs just stopped being read
+    if (inputPaused_) {
+        av_read_play(formatCtx_.get());
+        inputPaused_ = false;
+    }
+    avcodec_flush_buffers(codecCtx_.get());
+    awaitingKeyframe_ = true;
+    discardHeldFrame();
+}
+
+uint64_t StreamSession::packetArrivalTime(int64_t pts) const {
+    if (pts == AV_NOPTS_VALUE) return 0;
+    for (const PacketArrival& arrival : packetArrivals_) {
+        if (arrival.pts == pts) return arrival.timeUs;
+    }
+    return 0;
+}
+
+// Fill frame number and computer/hardware timestamps
+void StreamSession::stampFrame(Frame& frame, int64_t pts, uint64_t receiveTimeUs) {
+    frame.frameNumber = frameCounter_++;
+
+    // Computer receive time (microseconds and milliseconds since epoch)
+    frame.computerTimeUs = receiveTimeUs;
+    frame.computerTimeMs = frame.computerTimeUs / 1000;
+    frame.packetTimeUs = packetArrivalTime(pts);
+
+    // Extract hardware timestamp (convert PTS to nanoseconds)
+    // The PTS is in units of the stream timebase (typically 1/90000 for RTP video)
+    if (pts != AV_NOPTS_VALUE) {
+        double ptsSec = (double)pts * av_q2d(videoTimebase_);
+        frame.hardwareTimeNs = (uint64_t)(ptsSec * 1e9);
+        frame.hwTimeValid = true;
+    } else {
+        // Fallback: use computer time if hardware timestamp unavailable
+        frame.hardwareTimeNs = frame.computerTimeMs * 1000000;
+        frame.hwTimeValid = false;
+    }
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+#include "Frame.hpp"
+#include "FrameKernels.hpp"
+#include "FFmpegHandles.hpp"
+#include "FrameDecimator.hpp"
+#include "PacketRecording.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Accumulates per-interval statistics from demuxed video packets
+class PacketStatsAccumulator {
+public:
+    void add(const AVPacket* packet, AVRational timebase);
+
+    // Produce a snapshot for the elapsed interval and start a new one
+    PacketStats flush(double elapsedSec);
+
+private:
+    uint64_t packets_ = 0;
+    uint64_t keyPackets_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t keyBytes_ = 0;
+    uint64_t deltaBytes_ = 0;
+    uint32_t minBytes_ = UINT32_MAX;
+    uint32_t maxBytes_ = 0;
+    uint32_t gopLength_ = 0;
+    uint64_t packetsSinceKey_ = 0;
+    bool sawKey_ = false;
+    int64_t lastPts_ = AV_NOPTS_VALUE;
+    double ptsDeltaSum_ = 0.0;
+    double ptsDeltaSqSum_ = 0.0;
+    uint64_t ptsDeltaCount_ = 0;
+    uint64_t totalPackets_ = 0;
+    uint64_t totalBytes_ = 0;
+};
+
+// Result of a single pipeline stage
+enum class StageResult {
+    Ok,         // Stage produced output for the next one
+    Again,      // Nothing to hand on yet (other stream, decoder needs input)
+    Skipped,    // Packet discarded while resyncing on a keyframe
+    Error,      // Stage failed; see StreamSession::lastError()
+    EndOfStream // Replay reached the end of its recording
+};
+
+// One connected input stream and everything needed to turn its packets into
+// Frames. All FFmpeg objects are owned by RAII handles, so any early return
+// releases them. The capture loop drives the stages explicitly:
+//
+//   demux()  -> one video packet in packet()
+//   decode() -> one decoded picture (or the packet itself, for passthrough)
+//   select() -> how many pictures go on to convert (decimation; 0-2)
+//   convert()-> a stamped Frame in its kernel layout, once per selected picture
+//
+// Publishing the frame to the writers stays with the caller.
+class StreamSession {
+public:
+    // grayscale selects luma-only kernels (Gray8 frames)
+    StreamSession(const std::string& url, bool passthrough, bool grayscale = false);
+
+    // Record every demuxed video packet with its arrival time (before open)
+    void setRecording(const std::string& path);
+
+    // Read packets from a recording instead of connecting to url (before open).
+    // realTime reproduces the recorded arrival gaps; otherwise as fast as possible.
+    void setReplay(const std::string& path, bool realTime);
+
+    // Connect, find the video stream and open its decoder.
+    // On failure lastErrorType()/lastError() describe the problem.
+    bool open();
+
+    StageResult demux();
+    StageResult decode();
+    int select();
+    bool convert(Frame& frame);
+
+    // Convert the newest decoded picture whether or not select() picked it,
+    // without consuming a frame number (snapshots). Not for passthrough.
+    bool convertLatest(Frame& frame);
+
+    // Keep only the decoded frames nearest to an outputFps grid, on host
+    // (wall-clock) time or the stream's hardware time. Call before the first
+    // decode; passthrough is not decimated.
+    void setDecimation(double outputFps, bool hardwareClock);
+    const FrameDecimator* decimator() const { return decimator_.get(); }
+
+    // True once after the picture size or format changed mid-stream.
+    // The new kernels are in place by then; lastRebuildUs() is what it cost.
+    bool takeModeChange();
+    uint64_t lastRebuildUs() const { return lastRebuildUs_; }
+
+    // Hand back the interval's packet stats once per intervalMs
+    bool takePacketStats(PacketStats& stats, int intervalMs = 1000);
+
+    // Stop reading from the camera (RTSP PAUSE where supported)
+    void pauseInput();
+
+    // Resume reading and discard packets up to the next keyframe
+    void resumeInput();
+
+    ErrorType lastErrorType() const { return errorType_; }
+    const std::string& lastError() const { return error_; }
+
+    int width() const { return mode_.width; }
+    int height() const { return mode_.height; }
+    bool passthrough() const { return passthrough_; }
+    const FrameKernels& kernels() const { return *kernels_; }
+
+private:
+    bool fail(ErrorType type, const std::string& message);
+    bool openInput(const AVCodecParameters*& codecpar);
+    StageResult readReplayPacket(uint64_t& arrivalUs);
+    const FrameKernels& selectKernels() const;
+    void stampFrame(Frame& frame, int64_t pts, uint64_t receiveTimeUs);
+    void discardHeldFrame();
+    uint64_t packetArrivalTime(int64_t pts) const;
+
+    std::string url_;
+    bool passthrough_;
+    bool grayscale_;
+
+    InputFormatPtr formatCtx_;       // Null when replaying a recording
+    CodecContextPtr codecCtx_;
+    AVFramePtr rawFrame_;
+    AVPacketPtr packet_;
+    uint64_t decodedTimeUs_ = 0;   // Wall-clock time rawFrame_ was decoded
+    int videoStreamIdx_ = -1;
+    AVRational videoTimebase_{1, 90000};
+
+    // Picture parameters the kernels were selected for
+    struct StreamMode {
+        int width = 0;
+        int height = 0;
+        int pixFmt = -1;
+        bool fullRange = false;
+
+        bool operator!=(const StreamMode& other) const {
+            return width != other.width || height != other.height ||
+                   pixFmt != other.pixFmt || fullRange != other.fullRange;
+        }
+    };
+
+    // Convert + encode kernels, reselected only when the stream mode changes
+    StreamMode mode_;
+    const FrameKernels* kernels_ = nullptr;
+    ConvertScratch convertScratch_;
+    bool rebuildPending_ = false;
+    bool modeChanged_ = false;
+    uint64_t rebuildStartUs_ = 0;
+    uint64_t lastRebuildUs_ = 0;
+
+    // Packet recording and replay
+    std::string recordPath_;
+    std::string replayPath_;
+    bool replayRealTime_ = true;
+    std::unique_ptr<PacketRecorder> recorder_;
+    std::unique_ptr<PacketReplay> replay_;
+    bool replayStarted_ = false;
+    uint64_t replayStartUs_ = 0;        // Steady clock at the first replayed packet
+    uint64_t replaySystemStartUs_ = 0;  // System clock at the same moment
+    uint64_t replayFirstUs_ = 0;        // Recorded arrival of the first packet
+
+    // Decimation: the candidate picture held for one frame of lookahead, and
+    // the pictures select() passed on to convert()
+    std::unique_ptr<FrameDecimator> decimator_;
+    bool decimateOnHardwareTime_ = false;
+    AVFramePtr heldFrame_;
+    uint64_t heldDecodedUs_ = 0;
+    bool pendingHold_ = false;
+    struct ReadyPicture {
+        const AVFrame* frame;
+        uint64_t decodedTimeUs;
+    };
+    ReadyPicture ready_[2] = {};
+    int readyCount_ = 0;
+    int readyNext_ = 0;
+
+    // Packet demux times by PTS, so decoded frames can report how long
+    // they spent inside the decoder
+    struct PacketArrival {
+        int64_t pts = AV_NOPTS_VALUE;
+        uint64_t timeUs = 0;
+    };
+    static constexpr size_t kPacketArrivalSlots = 32;
+    PacketArrival packetArrivals_[kPacketArrivalSlots];
+    size_t packetArrivalNext_ = 0;
+
+    PacketStatsAccumulator packetAccumulator_;
+    uint64_t lastPacketStatsUs_ = 0;
+
+    uint64_t frameCounter_ = 0;
+    bool inputPaused_ = false;
+    bool awaitingKeyframe_ = false;
+
+    ErrorType errorType_ = ErrorType::Other;
+    std::string error_;
+};
@@ -0,0 +1,315 @@
+#include "VideoSegmentWriter.hpp"
+#include "FrameIndex.hpp"
+#include "OutputStriping.hpp"
+#include "FrameNotifier.hpp"
+#include "CpuAccounting.hpp"
+
+#include <sstream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+// Encoder timebase: milliseconds of computer receive time
+static const AVRational kEncoderTimebase = {1, 1000};
+
+VideoSegmentWriter::VideoSegmentWriter(const std::string& outputFolder,
+                                       const VideoSegmentOptions& options,
+                                       int encoderThreads,
+                                       FrameIndex* index,
+                                       OutputStriping* striping,
+                                       FrameNotifier* notifier)
+    : outputFolder_(outputFolder),
+      options_(options),
+      encoderThreads_(encoderThreads),
+      index_(index),
+      striping_(striping),
+      notifier_(notifier) {
+}
+
+VideoSegmentWriter::~VideoSegmentWriter() {
+    close();
+}
+
+bool VideoSegmentWriter::encoderAvailable() const {
+    return avcodec_find_encoder_by_name(options_.encoder.c_str()) != nullptr;
+}
+
+bool VideoSegmentWriter::fail(const std::string& message, const std::string& detail) {
+    lastError_ = message;
+    lastErrorDetail_ = detail;
+    closeSegment();
+    return false;
+}
+
+bool VideoSegmentWriter::openSegment(const Frame& frame) {
+    std::string folder = outputFolder_;
+    if (striping_) {
+        segmentRoot_ = striping_->acquire(0);
+        if (segmentRoot_ < 0) {
+            return fail("No output root has free space for a new segment");
+        }
+        segmentRootPath_ = striping_->root(segmentRoot_);
+        folder = segmentRootPath_;
+    }
+    segmentStartBytes_ = bytesWritten_;
+    segmentFirstFrame_ = frame.frameNumber;
+    segmentFirstHwNs_ = frame.hardwareTimeNs;
+    segmentFirstHwValid_ = frame.hwTimeValid;
+
+    const AVCodec* codec = avcodec_find_encoder_by_name(options_.encoder.c_str());
+    if (!codec) {
+        return fail("Video encoder not found: " + options_.encoder);
+    }
+
+    codecCtx_.reset(avcodec_alloc_context3(codec));
+    if (!codecCtx_) {
+        return fail("Failed to allocate encoder context");
+    }
+
+    codecCtx_->width = frame.width;
+    codecCtx_->height = frame.height;
+    codecCtx_->pix_fmt = AV_PIX_FMT_YUV420P;
+    codecCtx_->time_base = kEncoderTimebase;
+    codecCtx_->framerate = AVRational{options_.frameRate, 1};
+    codecCtx_->gop_size = options_.keyframeInterval;
+    codecCtx_->max_b_frames = 0;
+    codecCtx_->thread_count = encoderThreads_;
+
+    av_opt_set(codecCtx_->priv_data, "preset", options_.preset.c_str(), 0);
+    av_opt_set(codecCtx_->priv_data, "tune", options_.tune.c_str(), 0);
+    av_opt_set(codecCtx_->priv_data, "crf", std::to_string(options_.crf).c_str(), 0);
+
+    // Segment file named after the first frame, like the JPEG stills
+    std::ostringstream oss;
+    oss << formatComputerTime(frame.computerTimeMs)
+        << "_" << (frame.hwTimeValid ? "HW_" : "ERR_") << frame.hardwareTimeNs
+        << "." << options_.container;
+    segmentName_ = oss.str();
+    segmentPath_ = folder + "/" + segmentName_;
+
+    AVFormatContext* formatCtx = nullptr;
+    if (avformat_alloc_output_context2(&formatCtx, nullptr, nullptr, segmentPath_.c_str()) < 0 ||
+        !formatCtx) {
+        return fail("Failed to create muxer", segmentPath_);
+    }
+    formatCtx_.reset(formatCtx);
+
+    if (formatCtx_->oformat->flags & AVFMT_GLOBALHEADER) {
+        codecCtx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    // Encoder threads start here; they count toward this camera's encode stage
+    int opened;
+    {
+        CodecThreadScope encoderThreads(CpuStage::Encode);
+        opened = avcodec_open2(codecCtx_.get(), codec, nullptr);
+    }
+    if (opened < 0) {
+        return fail("Failed to open video encoder: " + options_.encoder);
+    }
+
+    stream_ = avformat_new_stream(formatCtx_.get(), nullptr);
+    if (!stream_) {
+        return fail("Failed to create output stream");
+    }
+    stream_->time_base = kEncoderTimebase;
+    avcodec_parameters_from_context(stream_->codecpar, codecCtx_.get());
+
+    if (!(formatCtx_->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&formatCtx_->pb, segmentPath_.c_str(), AVIO_FLAG_WRITE) < 0) {
+            return fail("Failed to open segment file", segmentPath_);
+        }
+    }
+
+    if (avformat_write_header(formatCtx_.get(), nullptr) < 0) {
+        return fail("Failed to write segment header", segmentPath_);
+    }
+    headerWritten_ = true;
+
+    yuvFrame_.reset(av_frame_alloc());
+    packet_.reset(av_packet_alloc());
+    if (!yuvFrame_ || !packet_) {
+        return fail("Failed to allocate encoder buffers");
+    }
+    yuvFrame_->format = AV_PIX_FMT_YUV420P;
+    yuvFrame_->width = frame.width;
+    yuvFrame_->height = frame.height;
+    if (av_frame_get_buffer(yuvFrame_.get(), 0) < 0) {
+        return fail("Failed to allocate encoder frame");
+    }
+
+    segmentStartMs_ = frame.computerTimeMs;
+    lastPts_ = -1;
+    segmentFrames_ = 0;
+    return true;
+}
+
+bool VideoSegmentWriter::encodeAndMux(AVFrame* frame) {
+    if (avcodec_send_frame(codecCtx_.get(), frame) < 0) {
+        return fail("Failed to send frame to video encoder");
+    }
+
+    while (true) {
+        int ret = avcodec_receive_packet(codecCtx_.get(), packet_.get());
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+        if (ret < 0) {
+            return fail("Video encoding error");
+        }
+
+        bytesWritten_ += packet_->size;
+        av_packet_rescale_ts(packet_.get(), codecCtx_->time_base, stream_->time_base);
+        packet_->stream_index = stream_->index;
+        uint64_t muxStartUs = steadyTimeUs();
+        ret = av_interleaved_write_frame(formatCtx_.get(), packet_.get());
+        muxUs_ += steadyTimeUs() - muxStartUs;
+        av_packet_unref(packet_.get());
+        if (ret < 0) {
+            return fail("Failed to write video packet", segmentPath_);
+        }
+    }
+    return true;
+}
+
+bool VideoSegmentWriter::write(const Frame& frame, FrameTiming& timing,
+                               const ImageStats& imageStats) {
+    uint64_t writeStartUs = steadyTimeUs();
+
+    // Roll over on duration or resolution change
+    if (codecCtx_) {
+        bool expired = frame.computerTimeMs - segmentStartMs_ >=
+                       static_cast<uint64_t>(options_.segmentSeconds) * 1000;
+        bool resized = frame.width != codecCtx_->width || frame.height != codecCtx_->height;
+        if (expired || resized) {
+            closeSegment();
+        }
+    }
+
+    if (!codecCtx_ && !openSegment(frame)) {
+        return false;
+    }
+
+    if (av_frame_make_writable(yuvFrame_.get()) < 0) {
+        return fail("Encoder frame not writable");
+    }
+
+    // Frames arrive as RGB24, full-range planar YCbCr or luma only depending on
+    // the session kernels; sws fills neutral chroma for Gray8
+    AVPixelFormat srcFormat = AV_PIX_FMT_RGB24;
+    if (frame.format == FrameFormat::Yuv420) {
+        srcFormat = AV_PIX_FMT_YUVJ420P;
+    } else if (frame.format == FrameFormat::Yuv422) {
+        srcFormat = AV_PIX_FMT_YUVJ422P;
+    } else if (frame.format == FrameFormat::Gray8) {
+        srcFormat = AV_PIX_FMT_GRAY8;
+    }
+
+    // Frees the old context itself when the parameters change
+    swsCtx_.reset(sws_getCachedContext(swsCtx_.release(),
+        frame.width, frame.height, srcFormat,
+        frame.width, frame.height, AV_PIX_FMT_YUV420P,
+        SWS_FAST_BILINEAR, nullptr, nullptr, nullptr));
+    if (!swsCtx_) {
+        return fail("Failed to create SWS context for video encode");
+    }
+
+    FramePlanes planes = framePlanes(frame);
+    sws_scale(swsCtx_.get(), planes.data, planes.linesize, 0, frame.height,
+              yuvFrame_->data, yuvFrame_->linesize);
+
+    // Millisecond PTS relative to segment start; must be strictly increasing
+    int64_t pts = static_cast<int64_t>(frame.computerTimeMs - segmentStartMs_);
+    if (pts <= lastPts_) {
+        pts = lastPts_ + 1;
+    }
+    yuvFrame_->pts = pts;
+    lastPts_ = pts;
+
+    uint64_t startBytes = bytesWritten_;
+    muxUs_ = 0;
+    if (!encodeAndMux(yuvFrame_.get())) {
+        return false;
+    }
+    // Convert and encode, then the muxing of whatever packets came out
+    timing.writeUs = muxUs_;
+    timing.encodeUs = steadyTimeUs() - writeStartUs - muxUs_;
+    int64_t segmentFrame = segmentFrames_++;
+
+    if (index_) {
+        // Bytes are the packets the encoder emitted for this call; without
+        // B-frames that is this frame once the encoder's lookahead is full
+        index_->append({
+            frame.frameNumber,
+            frame.computerTimeMs,
+            frame.hardwareTimeNs,
+            frame.hwTimeValid,
+            timing.latencyUs() / 1000,
+            timing,
+            frame.packetTimeUs,
+            frame.computerTimeUs,
+            systemTimeUs(),
+            bytesWritten_ - startBytes,
+            segmentName_,
+            av_rescale_q(pts, kEncoderTimebase, stream_->time_base),
+            -1,
+            segmentFrame,
+            frame.sei,
+            imageStats,
+            segmentRootPath_
+        });
+    }
+    return true;
+}
+
+void VideoSegmentWriter::closeSegment() {
+    if (headerWritten_ && packet_) {
+        // Drain delayed packets, then finalize the container
+        if (avcodec_send_frame(codecCtx_.get(), nullptr) >= 0) {
+            while (avcodec_receive_packet(codecCtx_.get(), packet_.get()) >= 0) {
+                bytesWritten_ += packet_->size;
+                av_packet_rescale_ts(packet_.get(), codecCtx_->time_base, stream_->time_base);
+                packet_->stream_index = stream_->index;
+                av_interleaved_write_frame(formatCtx_.get(), packet_.get());
+                av_packet_unref(packet_.get());
+            }
+        }
+        av_write_trailer(formatCtx_.get());
+        segmentsWritten_++;
+    }
+    bool finished = headerWritten_;
+    headerWritten_ = false;
+
+    formatCtx_.reset();
+    stream_ = nullptr;
+    codecCtx_.reset();
+    yuvFrame_.reset();
+    packet_.reset();
+
+    // Announce only after the file is closed and complete
+    if (finished && notifier_) {
+        FrameNotice notice;
+        notice.kind = "segment";
+        notice.frameNumber = segmentFirstFrame_;
+        notice.computerTimeMs = segmentStartMs_;
+        notice.hardwareTimeNs = segmentFirstHwNs_;
+        notice.hwTimeValid = segmentFirstHwValid_;
+        notice.bytes = bytesWritten_ - segmentStartBytes_;
+        notice.path = segmentPath_;
+        notifier_->send(notice);
+    }
+
+    if (segmentRoot_ >= 0) {
+        striping_->release(segmentRoot_, 0, bytesWritten_ - segmentStartBytes_, 0);
+        segmentRoot_ = -1;
+    }
+}
+
+void VideoSegmentWriter::close() {
+    closeSegment();
+    if (index_) index_->flush();
+    swsCtx_.reset();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "CameraFrameCapture.hpp"
+#include "Frame.hpp"
+#include "FFmpegHandles.hpp"
+#include "ImageStats.hpp"
+
+#include <string>
+
+class FrameIndex;
+class OutputStriping;
+class FrameNotifier;
+
+// Encodes decoded frames into rolling video segment files
+// (one encoder + muxer per segment, each segment starts on a keyframe),
+// recording each frame's segment, position and SEI in the index.
+// With striping, each segment goes to the least loaded output root.
+class VideoSegmentWriter {
+public:
+    VideoSegmentWriter(const std::string& outputFolder,
+                       const VideoSegmentOptions& options,
+                       int encoderThreads,
+                       FrameIndex* index = nullptr,
+                       OutputStriping* striping = nullptr,
+                       FrameNotifier* notifier = nullptr);
+    ~VideoSegmentWriter();
+
+    VideoSegmentWriter(const VideoSegmentWriter&) = delete;
+    VideoSegmentWriter& operator=(const VideoSegmentWriter&) = delete;
+
+    // True if the configured encoder is present in this libavcodec build
+    bool encoderAvailable() const;
+
+    // Encode one frame, rolling over to a new segment when due.
+    // `timing` carries the queue wait in and receives the encode and mux
+    // times; `imageStats` goes to the frame's index row.
+    // Returns false on failure; see lastError().
+    bool write(const Frame& frame, FrameTiming& timing, const ImageStats& imageStats);
+
+    // Flush the encoder and finalize the current segment
+    void close();
+
+    const std::string& lastError() const { return lastError_; }
+    const std::string& lastErrorDetail() const { return lastErrorDetail_; }   // Path, if any
+    uint64_t segmentsWritten() const { return segmentsWritten_; }
+    uint64_t bytesWritten() const { return bytesWritten_; }
+
+private:
+    bool openSegment(const Frame& frame);
+    void closeSegment();
+    bool encodeAndMux(AVFrame* frame);
+    bool fail(const std::string& message, const std::string& detail = "");
+
+    std::string outputFolder_;
+    VideoSegmentOptions options_;
+    int encoderThreads_;
+    FrameIndex* index_;
+    OutputStriping* striping_;
+    FrameNotifier* notifier_;
+
+    CodecContextPtr codecCtx_;
+    OutputFormatPtr formatCtx_;
+    AVStream* stream_ = nullptr;        // Owned by formatCtx_
+    AVFramePtr yuvFrame_;
+    AVPacketPtr packet_;
+    SwsContextPtr swsCtx_;
+
+    std::string segmentName_;
+    std::string segmentPath_;
+    int segmentRoot_ = -1;
+    std::string segmentRootPath_;       // Empty unless striping
+    uint64_t segmentStartBytes_ = 0;
+    uint64_t segmentFirstFrame_ = 0;     // First frame, announced with the finished segment
+    uint64_t segmentFirstHwNs_ = 0;
+    bool segmentFirstHwValid_ = false;
+    uint64_t segmentStartMs_ = 0;
+    bool headerWritten_ = false;
+    int64_t lastPts_ = -1;
+    int64_t segmentFrames_ = 0;         // Frames encoded into the current segment
+    uint64_t muxUs_ = 0;                // Time spent muxing during the current write()
+    uint64_t segmentsWritten_ = 0;
+    uint64_t bytesWritten_ = 0;
+    std::string lastError_;
+    std::string lastErrorDetail_;
+};
@@ -0,0 +1,267 @@
+#include "Frame.hpp"
+#include "JpegEncoder.hpp"
+#include "FileOutput.hpp"
+#include "VideoSegmentWriter.hpp"
+#include "FrameKernels.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/frame.h>
+}
+
+namespace fs = std::filesystem;
+
+// Process CPU time (user + system, all threads) in milliseconds
+static double processCpuMs() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+static uint64_t folderBytes(const std::string& folder) {
+    uint64_t total = 0;
+    for (const auto& entry : fs::directory_iterator(folder)) {
+        if (entry.is_regular_file()) total += entry.file_size();
+    }
+    return total;
+}
+
+// Synthetic camera-like content: moving gradient, a few edges and sensor noise
+static std::vector<Frame> makeFrames(int width, int height, int count) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> noise(-6, 6);
+    std::vector<Frame> frames(count);
+
+    for (int n = 0; n < count; ++n) {
+        Frame& frame = frames[n];
+        frame.width = width;
+        frame.height = height;
+        frame.frameNumber = n;
+        frame.computerTimeMs = 1700000000000ULL + n * 33;
+        frame.hardwareTimeNs = static_cast<uint64_t>(n) * 33333333ULL;
+        frame.hwTimeValid = true;
+        frame.data.resize(static_cast<size_t>(width) * height * 3);
+
+        uint8_t* p = frame.data.data();
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                int shift = x + n * 4;
+                bool box = ((shift / 160) + (y / 120)) % 2 == 0;
+                int base = box ? 180 : 60;
+                p[0] = static_cast<uint8_t>(std::clamp(base + (y * 60) / height + noise(rng), 0, 255));
+                p[1] = static_cast<uint8_t>(std::clamp(base - 20 + (shift % 255) / 8 + noise(rng), 0, 255));
+                p[2] = static_cast<uint8_t>(std::clamp(base - 40 + noise(rng), 0, 255));
+                p += 3;
+            }
+        }
+    }
+    return frames;
+}
+
+struct BenchResult {
+    double wallMsPerFrame;
+    double cpuMsPerFrame;
+    double kbPerFrame;
+};
+
+static BenchResult runBench(const std::vector<Frame>& frames, const std::string& folder,
+                            const std::function<void(const Frame&)>& encode,
+                            const std::function<void()>& finish) {
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+
+    double cpuStart = processCpuMs();
+    auto wallStart = std::chrono::steady_clock::now();
+
+    for (const Frame& frame : frames) {
+        encode(frame);
+    }
+    finish();
+
+    double wallMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    double cpuMs = processCpuMs() - cpuStart;
+    double count = static_cast<double>(frames.size());
+
+    return {wallMs / count, cpuMs / count, folderBytes(folder) / 1024.0 / count};
+}
+
+static void printRow(const std::string& name, const BenchResult& r) {
+    std::cout << std::setw(28) << name
+              << std::setw(14) << std::fixed << std::setprecision(2) << r.wallMsPerFrame
+              << std::setw(14) << r.cpuMsPerFrame
+              << std::setw(14) << std::setprecision(1) << r.kbPerFrame
+              << std::endl;
+}
+
+// Decoder-like source picture for the kernel benchmark
+static AVFrame* makeDecodedFrame(int width, int height, AVPixelFormat format) {
+    AVFrame* frame = av_frame_alloc();
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    av_frame_get_buffer(frame, 0);
+
+    bool chroma420 = format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P;
+    for (int plane = 0; plane < 3; ++plane) {
+        int planeWidth = plane ? width / 2 : width;
+        int planeHeight = (plane && chroma420) ? height / 2 : height;
+        for (int y = 0; y < planeHeight; ++y) {
+            uint8_t* row = frame->data[plane] + y * frame->linesize[plane];
+            for (int x = 0; x < planeWidth; ++x) {
+                row[x] = plane ? static_cast<uint8_t>(112 + (x + y) % 32)
+                               : static_cast<uint8_t>(32 + (((x / 160) + (y / 120)) % 2) * 128 + (x * 48) / planeWidth);
+            }
+        }
+    }
+    return frame;
+}
+
+// Convert + encode cost per kernel tier for the known FLIR modes
+static void benchKernels(int frameCount, int jpegQuality) {
+    struct Mode {
+        const char* label;
+        int width;
+        int height;
+        AVPixelFormat format;
+    };
+    const Mode modes[] = {
+        {"1920x1080 YUV420P", 1920, 1080, AV_PIX_FMT_YUV420P},
+        {"1280x720 YUVJ422P", 1280, 720, AV_PIX_FMT_YUVJ422P},
+    };
+    const std::pair<KernelTier, const char*> tiers[] = {
+        {KernelTier::Generic, "generic"},
+        {KernelTier::Planar, "planar"},
+        {KernelTier::Specialized, "specialized"},
+    };
+
+    std::cout << std::endl;
+    std::cout << "=== Convert + Encode Kernels (" << frameCount << " frames per run) ===" << std::endl;
+    std::cout << std::setw(20) << "Mode"
+              << std::setw(14) << "Tier"
+              << std::setw(12) << "Conv ms"
+              << std::setw(12) << "Enc ms"
+              << std::setw(12) << "Total ms"
+              << std::setw(10) << "Speedup"
+              << std::endl;
+    std::cout << std::string(80, '-') << std::endl;
+
+    for (const Mode& mode : modes) {
+        AVFrame* source = makeDecodedFrame(mode.width, mode.height, mode.format);
+        double genericTotal = 0.0;
+
+        auto run = [&](const FrameKernels& kernels, const char* label) {
+            ConvertScratch scratch;
+            Frame frame;
+            std::vector<uint8_t> jpeg;
+            double convertMs = 0.0;
+            double encodeMs = 0.0;
+
+            for (int n = 0; n < frameCount; ++n) {
+                auto t0 = std::chrono::steady_clock::now();
+                kernels.convert(source, frame, scratch);
+                auto t1 = std::chrono::steady_clock::now();
+                kernels.encode(frame, jpegQuality, jpeg);
+                auto t2 = std::chrono::steady_clock::now();
+                convertMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+                encodeMs += std::chrono::duration<double, std::milli>(t2 - t1).count();
+            }
+
+            convertMs /= frameCount;
+            encodeMs /= frameCount;
+            double total = convertMs + encodeMs;
+            if (genericTotal == 0.0) genericTotal = total;
+
+            std::cout << std::setw(20) << mode.label
+                      << std::setw(14) << label
+                      << std::setw(12) << std::fixed << std::setprecision(2) << convertMs
+                      << std::setw(12) << encodeMs
+                      << std::setw(12) << total
+                      << std::setw(9) << std::setprecision(2) << genericTotal / total << "x"
+                      << std::endl;
+        };
+
+        // Generic runs first and is the speedup baseline
+        for (const auto& tier : tiers) {
+            run(selectFrameKernels(mode.width, mode.height, mode.format, false, tier.first),
+                tier.second);
+        }
+        run(selectGrayKernels(mode.format, false), "gray");
+
+        av_frame_free(&source);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int frameCount = argc > 1 ? std::stoi(argv[1]) : 300;
+    std::string outputRoot = argc > 2 ? argv[2] : "/tmp/camera_bench";
+    int jpegQuality = 85;
+
+    std::cout << "=== Encode Benchmark (" << frameCount << " frames per run) ===" << std::endl;
+    std::cout << std::setw(28) << "Path"
+              << std::setw(14) << "Wall ms/f"
+              << std::setw(14) << "CPU ms/f"
+              << std::setw(14) << "KB/f"
+              << std::endl;
+    std::cout << std::string(70, '-') << std::endl;
+
+    const std::pair<int, int> resolutions[] = {{1280, 720}, {1920, 1080}};
+    for (const auto& res : resolutions) {
+        int width = res.first;
+        int height = res.second;
+        std::string label = std::to_string(width) + "x" + std::to_string(height);
+        std::vector<Frame> frames = makeFrames(width, height, frameCount);
+
+        // Current per-frame JPEG path (encode to memory, then write)
+        std::string jpegFolder = outputRoot + "/jpeg_" + label;
+        std::vector<uint8_t> jpegBuffer;
+        BenchResult jpeg = runBench(frames, jpegFolder,
+            [&](const Frame& frame) {
+                std::string path = jpegFolder + "/" + std::to_string(frame.frameNumber) + ".jpg";
+                encodeFrameToJPEG(frame, jpegQuality, jpegBuffer);
+                writeFileContents(path, jpegBuffer.data(), jpegBuffer.size());
+            },
+            [] {});
+        printRow(label + " JPEG q" + std::to_string(jpegQuality), jpeg);
+
+        // Video segment path, single-threaded encoder for a per-core comparison
+        for (const char* encoder : {"libx264", "libx265"}) {
+            VideoSegmentOptions options;
+            options.encoder = encoder;
+            std::string videoFolder = outputRoot + "/" + encoder + "_" + label;
+            fs::create_directories(videoFolder);
+            VideoSegmentWriter writer(videoFolder, options, 1);
+            if (!writer.encoderAvailable()) {
+                std::cout << std::setw(28) << (label + " " + encoder) << "  (encoder not available)" << std::endl;
+                continue;
+            }
+
+            BenchResult video = runBench(frames, videoFolder,
+                [&](const Frame& frame) {
+                    FrameTiming timing;
+                    if (!writer.write(frame, timing, ImageStats{})) {
+                        std::cerr << writer.lastError() << std::endl;
+                    }
+                },
+                [&] { writer.close(); });
+            printRow(label + " " + encoder + " " + options.preset, video);
+        }
+    }
+
+    benchKernels(frameCount, jpegQuality);
+
+    return 0;
+}
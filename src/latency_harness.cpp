@@ -0,0 +1,358 @@
+#include "CameraFrameCapture.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avutil.h>
+#include <libavutil/opt.h>
+#include <jpeglib.h>
+}
+
+namespace fs = std::filesystem;
+
+// Source timestamps are burned into the top of each frame as a 64-bit
+// barcode (one row of bits, one row of their complement for validation)
+static const int kBarcodeBits = 64;
+
+static int barcodeCellSize(int width) {
+    return width / kBarcodeBits >= 16 ? 16 : 8;
+}
+
+static uint64_t wallTimeUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+struct SourceConfig {
+    std::string url;           // Where the stand-in source sends its stream
+    std::string format;        // Muxer: mpegts (tcp) or rtsp (publish)
+    std::string codec;         // mjpeg or h264
+    int width;
+    int height;
+    int fps;
+};
+
+// Draw background and timestamp barcode into a YUV420 frame
+static void drawSourceFrame(AVFrame* frame, int64_t index, uint64_t timestampUs) {
+    int width = frame->width;
+    int height = frame->height;
+
+    // Moving gradient so the encoder sees realistic motion
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < width; ++x) {
+            row[x] = static_cast<uint8_t>(64 + ((x + index * 8) % 128) / 2 + (y * 64) / height);
+        }
+    }
+    for (int plane = 1; plane < 3; ++plane) {
+        for (int y = 0; y < height / 2; ++y) {
+            memset(frame->data[plane] + y * frame->linesize[plane], 128, width / 2);
+        }
+    }
+
+    int cell = barcodeCellSize(width);
+    for (int bitRow = 0; bitRow < 2; ++bitRow) {
+        for (int bit = 0; bit < kBarcodeBits; ++bit) {
+            bool set = ((timestampUs >> (kBarcodeBits - 1 - bit)) & 1) != static_cast<uint64_t>(bitRow);
+            uint8_t value = set ? 235 : 16;
+            for (int y = bitRow * cell; y < (bitRow + 1) * cell; ++y) {
+                memset(frame->data[0] + y * frame->linesize[0] + bit * cell, value, cell);
+            }
+        }
+    }
+}
+
+// Stand-in camera: encode frames carrying their send time and stream them
+static void runSource(const SourceConfig& config, const std::atomic<bool>& stop,
+                      std::atomic<uint64_t>& framesSent) {
+    bool mjpeg = config.codec == "mjpeg";
+    const AVCodec* codec = mjpeg ? avcodec_find_encoder(AV_CODEC_ID_MJPEG)
+                                 : avcodec_find_encoder_by_name("libx264");
+    if (!codec) {
+        std::cerr << "Source: encoder not available for " << config.codec << std::endl;
+        return;
+    }
+
+    AVCodecContext* codecCtx = avcodec_alloc_context3(codec);
+    codecCtx->width = config.width;
+    codecCtx->height = config.height;
+    codecCtx->time_base = AVRational{1, config.fps};
+    codecCtx->framerate = AVRational{config.fps, 1};
+    codecCtx->gop_size = config.fps;
+    codecCtx->max_b_frames = 0;
+    if (mjpeg) {
+        codecCtx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        codecCtx->flags |= AV_CODEC_FLAG_QSCALE;
+        codecCtx->global_quality = FF_QP2LAMBDA * 3;
+    } else {
+        codecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+        av_opt_set(codecCtx->priv_data, "preset", "ultrafast", 0);
+        av_opt_set(codecCtx->priv_data, "tune", "zerolatency", 0);
+    }
+
+    AVFormatContext* formatCtx = nullptr;
+    avformat_alloc_output_context2(&formatCtx, nullptr, config.format.c_str(), config.url.c_str());
+    if (!formatCtx || avcodec_open2(codecCtx, codec, nullptr) < 0) {
+        std::cerr << "Source: failed to set up encoder/muxer" << std::endl;
+        avcodec_free_context(&codecCtx);
+        if (formatCtx) avformat_free_context(formatCtx);
+        return;
+    }
+    formatCtx->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+    formatCtx->max_delay = 0;
+
+    AVStream* stream = avformat_new_stream(formatCtx, nullptr);
+    stream->time_base = codecCtx->time_base;
+    avcodec_parameters_from_context(stream->codecpar, codecCtx);
+
+    // The capture side listens; retry until it is accepting connections
+    if (!(formatCtx->oformat->flags & AVFMT_NOFILE)) {
+        while (!stop.load() && avio_open(&formatCtx->pb, config.url.c_str(), AVIO_FLAG_WRITE) < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    AVFrame* frame = av_frame_alloc();
+    AVPacket* packet = av_packet_alloc();
+    frame->format = codecCtx->pix_fmt;
+    frame->width = config.width;
+    frame->height = config.height;
+    av_frame_get_buffer(frame, 0);
+
+    bool ready = !stop.load() && avformat_write_header(formatCtx, nullptr) >= 0;
+    if (!ready) {
+        std::cerr << "Source: failed to start stream to " << config.url << std::endl;
+    }
+
+    auto interval = std::chrono::microseconds(1000000 / config.fps);
+    auto nextTick = std::chrono::steady_clock::now();
+    int64_t index = 0;
+
+    while (ready && !stop.load()) {
+        std::this_thread::sleep_until(nextTick);
+        nextTick += interval;
+
+        av_frame_make_writable(frame);
+        drawSourceFrame(frame, index, wallTimeUs());
+        frame->pts = index++;
+
+        if (avcodec_send_frame(codecCtx, frame) < 0) break;
+        while (avcodec_receive_packet(codecCtx, packet) >= 0) {
+            av_packet_rescale_ts(packet, codecCtx->time_base, stream->time_base);
+            packet->stream_index = stream->index;
+            av_interleaved_write_frame(formatCtx, packet);
+            av_packet_unref(packet);
+        }
+        framesSent.fetch_add(1);
+    }
+
+    if (ready) av_write_trailer(formatCtx);
+    if (formatCtx->pb && !(formatCtx->oformat->flags & AVFMT_NOFILE)) avio_closep(&formatCtx->pb);
+    avformat_free_context(formatCtx);
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&codecCtx);
+}
+
+// Read the timestamp barcode back from a written JPEG (0 if unreadable)
+static uint64_t readBarcode(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return 0;
+
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+
+    int width = cinfo.output_width;
+    int cell = barcodeCellSize(width);
+    std::vector<uint8_t> rows(static_cast<size_t>(width) * cell * 2);
+    while (cinfo.output_scanline < static_cast<JDIMENSION>(cell * 2)) {
+        JSAMPROW row = rows.data() + cinfo.output_scanline * width;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+
+    uint64_t value = 0;
+    uint64_t complement = 0;
+    for (int bit = 0; bit < kBarcodeBits; ++bit) {
+        int x = bit * cell + cell / 2;
+        value = (value << 1) | (rows[(cell / 2) * width + x] > 128 ? 1 : 0);
+        complement = (complement << 1) | (rows[(cell + cell / 2) * width + x] > 128 ? 1 : 0);
+    }
+    return (value ^ complement) == ~0ULL ? value : 0;
+}
+
+static std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ',')) fields.push_back(field);
+    return fields;
+}
+
+static void printDistribution(const std::string& name, std::vector<double> valuesMs) {
+    if (valuesMs.empty()) return;
+    std::sort(valuesMs.begin(), valuesMs.end());
+    double sum = 0.0;
+    for (double v : valuesMs) sum += v;
+    auto percentile = [&](double p) {
+        return valuesMs[std::min(valuesMs.size() - 1, static_cast<size_t>(p * valuesMs.size()))];
+    };
+
+    std::cout << std::setw(22) << name << std::fixed << std::setprecision(2)
+              << std::setw(10) << sum / valuesMs.size()
+              << std::setw(10) << percentile(0.5)
+              << std::setw(10) << percentile(0.9)
+              << std::setw(10) << percentile(0.99)
+              << std::setw(10) << valuesMs.back()
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <mjpeg|h264> <width>x<height> <seconds> [rtsp_publish_url]" << std::endl;
+        std::cerr << std::endl;
+        std::cerr << "Without a URL the stand-in source streams MPEG-TS over local TCP." << std::endl;
+        std::cerr << "With an RTSP URL it publishes to an external RTSP server (e.g. mediamtx)" << std::endl;
+        std::cerr << "and the driver captures from the same URL, including RTSP buffering." << std::endl;
+        return 1;
+    }
+
+    SourceConfig source;
+    source.codec = argv[1];
+    if (sscanf(argv[2], "%dx%d", &source.width, &source.height) != 2) {
+        std::cerr << "Invalid resolution: " << argv[2] << std::endl;
+        return 1;
+    }
+    source.fps = 30;
+    int seconds = std::stoi(argv[3]);
+
+    std::string captureUrl;
+    if (argc > 4) {
+        source.url = argv[4];
+        source.format = "rtsp";
+        captureUrl = source.url;
+    } else {
+        source.url = "tcp://127.0.0.1:5600";
+        source.format = "mpegts";
+        captureUrl = "tcp://127.0.0.1:5600?listen=1";
+    }
+
+    std::string outputFolder = "/tmp/camera_latency_harness";
+    fs::remove_all(outputFolder);
+
+    CameraFrameCapture capture(captureUrl, outputFolder, 4, 85);
+    capture.setFrameIndexEnabled(true);
+    capture.setLatencyUnit(LatencyUnit::Microseconds);
+    capture.setErrorCallback([](const ErrorInfo& error) {
+        std::cerr << "[" << (error.isFatal ? "FATAL" : "WARNING") << "] " << error.message;
+        if (!error.detail.empty()) std::cerr << " - " << error.detail;
+        std::cerr << std::endl;
+    });
+
+    std::atomic<bool> stopSource{false};
+    std::atomic<uint64_t> framesSent{0};
+
+    std::cout << "=== Glass-to-Disk Latency Harness ===" << std::endl;
+    std::cout << "Source: " << source.codec << " " << source.width << "x" << source.height
+              << " @ " << source.fps << " fps -> " << source.url << std::endl;
+
+    // RTSP publish must be up before the driver connects; local TCP is the reverse
+    std::thread sourceThread;
+    if (source.format == "rtsp") {
+        sourceThread = std::thread(runSource, std::cref(source), std::cref(stopSource), std::ref(framesSent));
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        capture.start();
+    } else {
+        capture.start();
+        sourceThread = std::thread(runSource, std::cref(source), std::cref(stopSource), std::ref(framesSent));
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stopSource.store(true);
+    sourceThread.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));  // Let writers drain
+    capture.stop();
+
+    // Correlate the index with the timestamps decoded from each written frame
+    std::ifstream index(outputFolder + "/index.csv");
+    std::string line;
+    std::getline(index, line);
+    std::map<std::string, size_t> column;
+    std::vector<std::string> header = splitCsv(line);
+    for (size_t i = 0; i < header.size(); ++i) column[header[i]] = i;
+
+    std::vector<double> sourceToDemux, demuxToDecoded, queueWait, encode, write, glassToDisk;
+    uint64_t unreadable = 0;
+
+    while (std::getline(index, line)) {
+        std::vector<std::string> fields = splitCsv(line);
+        if (fields.size() != header.size()) continue;
+
+        uint64_t sourceUs = readBarcode(outputFolder + "/" + fields[column["file"]]);
+        if (sourceUs == 0) {
+            unreadable++;
+            continue;
+        }
+
+        auto us = [&](const char* name) { return std::stod(fields[column[name]]); };
+        double packetUs = us("packet_time_us");
+        double receiveUs = us("receive_time_us");
+
+        if (packetUs > 0) {
+            sourceToDemux.push_back((packetUs - sourceUs) / 1000.0);
+            demuxToDecoded.push_back((receiveUs - packetUs) / 1000.0);
+        }
+        queueWait.push_back(us("queue_wait_us") / 1000.0);
+        encode.push_back(us("encode_us") / 1000.0);
+        write.push_back(us("write_us") / 1000.0);
+        glassToDisk.push_back((us("commit_time_us") - sourceUs) / 1000.0);
+    }
+
+    auto stats = capture.getStats();
+    std::cout << std::endl;
+    std::cout << "Frames sent: " << framesSent.load()
+              << " | Written: " << stats.writtenFrames
+              << " | Dropped: " << stats.droppedFrames
+              << " | Unreadable timestamps: " << unreadable << std::endl;
+    std::cout << std::endl;
+    std::cout << std::setw(22) << "Stage (ms)"
+              << std::setw(10) << "Mean"
+              << std::setw(10) << "p50"
+              << std::setw(10) << "p90"
+              << std::setw(10) << "p99"
+              << std::setw(10) << "Max"
+              << std::endl;
+    std::cout << std::string(72, '-') << std::endl;
+    printDistribution("Source -> demux", sourceToDemux);
+    printDistribution("Demux -> decoded", demuxToDecoded);
+    printDistribution("Queue wait", queueWait);
+    printDistribution("Encode", encode);
+    printDistribution("Write", write);
+    std::cout << std::string(72, '-') << std::endl;
+    printDistribution("Glass -> disk", glassToDisk);
+
+    return 0;
+}
@@ -68,7 +68,19 @@ int main(int argc, char* argv[]) {
         }
 
         std::string severity = error.isFatal ? "FATAL" : "WARNING";
-        std::cerr << "[" << severity << "] " << typeStr << ": " << error.message << std::endl;
+        std::cerr << "[" << severity << "] " << typeStr << ": " << error.message;
+        if (!error.detail.empty()) {
+            std::cerr << " - ";
+            if (error.count > 1 && error.firstDetail != error.detail) {
+                std::cerr << error.firstDetail << " ... ";
+            }
+            std::cerr << error.detail;
+        }
+        if (error.count > 1) {
+            std::cerr << " (x" << error.count << " over "
+                      << (error.lastTimestamp - error.firstTimestamp) / 1000000 << " ms)";
+        }
+        std::cerr << std::endl;
     });
 
     // Start capture
@@ -88,14 +100,17 @@ int main(int argc, char* argv[]) {
 
     // Monitor and print stats every second
     std::cout << "Running capture. Press Ctrl+C to stop." << std::endl;
-    std::cout << std::string(80, '-') << std::endl;
+    std::cout << std::string(116, '-') << std::endl;
     std::cout << std::setw(20) << "Time"
               << std::setw(15) << "Captured"
               << std::setw(15) << "Written"
               << std::setw(15) << "Dropped"
               << std::setw(15) << "FPS"
+              << std::setw(12) << "Kbps"
+              << std::setw(8) << "GOP"
+              << std::setw(8) << "I/P"
               << std::endl;
-    std::cout << std::string(80, '-') << std::endl;
+    std::cout << std::string(116, '-') << std::endl;
 
     auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -103,6 +118,7 @@ int main(int argc, char* argv[]) {
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 
         auto stats = capture.getStats();
+        auto packetStats = capture.getPacketStats();
         auto now = std::chrono::high_resolution_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - startTime);
 
@@ -112,10 +128,13 @@ int main(int argc, char* argv[]) {
                   << std::setw(15) << stats.droppedFrames
                   << std::setw(15) << std::fixed << std::setprecision(1) << stats.currentFPS
                   << " Hz"
+                  << std::setw(12) << std::setprecision(0) << packetStats.bitrateKbps
+                  << std::setw(8) << packetStats.gopLength
+                  << std::setw(8) << std::setprecision(1) << packetStats.keyToDeltaRatio
                   << std::endl;
     }
 
-    std::cout << std::string(80, '-') << std::endl;
+    std::cout << std::string(116, '-') << std::endl;
     std::cout << "Capture stopped." << std::endl;
 
     // Final stats
@@ -126,6 +145,35 @@ int main(int argc, char* argv[]) {
     std::cout << "  Written frames: " << stats.writtenFrames << std::endl;
     std::cout << "  Dropped frames: " << stats.droppedFrames << std::endl;
     std::cout << "  Last FPS: " << std::fixed << std::setprecision(1) << stats.currentFPS << std::endl;
+    std::cout << "  Backpressure pauses: " << stats.pauseCount
+              << " (" << stats.pausedTimeMs << " ms, " << stats.skippedPackets << " packets skipped)" << std::endl;
+    std::cout << "  Decimated frames: " << stats.decimatedFrames
+              << " (" << stats.missedSlots << " missed slots, jitter " << std::setprecision(2)
+              << stats.selectionJitterMs << " ms mean, " << stats.maxSelectionJitterMs << " ms max, "
+              << stats.slotGridResets << " grid resets)" << std::endl;
+    std::cout << "  Staged frames migrated: " << stats.migratedFrames
+              << " (" << stats.stagedFrames << " still staged, " << stats.stagingOverflows
+              << " overflows)" << std::endl;
+
+    auto packetStats = capture.getPacketStats();
+    std::cout << "  Stream packets: " << packetStats.totalPackets << std::endl;
+    std::cout << "  Stream bytes: " << packetStats.totalBytes << std::endl;
+
+    auto cpuStats = capture.getCpuStats();
+    std::cout << "  CPU: " << std::setprecision(1) << cpuStats.cpuPercent << "% of one core over "
+              << cpuStats.wallSec << " s" << std::endl;
+    for (const auto& stage : cpuStats.stages) {
+        std::cout << "    " << std::left << std::setw(18) << stage.stage << std::right
+                  << std::setw(8) << stage.cpuPercent << "%  (" << stage.cpuUs / 1000 << " ms, "
+                  << stage.calls << " calls)" << std::endl;
+    }
+    for (const auto& thread : cpuStats.threads) {
+        std::cout << "    " << std::left << std::setw(18) << thread.name << std::right
+                  << std::setw(8) << thread.cpuPercent << "%  (" << thread.voluntarySwitches
+                  << " voluntary / " << thread.involuntarySwitches << " involuntary switches, "
+                  << thread.minorFaults << " minor / " << thread.majorFaults << " major faults)"
+                  << std::endl;
+    }
 
     return 0;
 }